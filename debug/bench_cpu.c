@@ -0,0 +1,247 @@
+/*
+ * Copyright 2012-2022 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/MD.
+ *
+ * adriagipas/MD is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/MD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/MD.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  bench_cpu.c - Mesura la velocitat de l'intèrpret del 68000.
+ *
+ *  Executa MD_cpu_run en un bucle, sense rellotjar la resta de xips,
+ *  fins a consumir els cicles indicats i mostra les instruccions per
+ *  segon. Per a comparar dos versions convé fer diverses execucions
+ *  alternades i quedar-se amb la mediana. Es compila des d'esta
+ *  carpeta amb:
+ *
+ *    gcc -O2 -std=gnu99 -D__LITTLE_ENDIAN__ -I../src -I../py/Z80/src \
+ *        -o bench_cpu bench_cpu.c ../src/[a-z]*.c ../py/Z80/src/z80.c \
+ *        ../py/Z80/src/z80_dis.c -lm
+ *
+ *  Ús: bench_cpu <rom> [<cicles>]
+ *
+ */
+
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "MD.h"
+
+
+
+
+/**********/
+/* MACROS */
+/**********/
+
+/* Cicles per defecte. */
+#define NCC_DEF 200000000LL
+
+
+
+
+/*********************/
+/* FUNCIONS PRIVADES */
+/*********************/
+
+static void
+warning (
+         void       *udata,
+         const char *format,
+         ...
+         )
+{
+} /* end warning */
+
+
+static void
+sres_changed (
+              const int  width,
+              const int  height,
+              void      *udata
+              )
+{
+} /* end sres_changed */
+
+
+static void
+update_screen (
+               const int  fb[],
+               void      *udata
+               )
+{
+} /* end update_screen */
+
+
+static void
+play_sound (
+            const MDs16  samples[MD_FM_BUFFER_SIZE*2],
+            void        *udata
+            )
+{
+} /* end play_sound */
+
+
+static MD_Word *
+get_static_ram (
+        	const int  num_words,
+        	void      *udata
+        	)
+{
+  return (MD_Word *) calloc ( num_words, sizeof(MD_Word) );
+} /* end get_static_ram */
+
+
+static MDu8 *
+get_eeprom (
+            const size_t  nbytes,
+            const MDu8    init_val,
+            void         *udata
+            )
+{
+  
+  MDu8 *ret;
+  
+  
+  ret= (MDu8 *) malloc ( nbytes );
+  if ( ret != NULL ) memset ( ret, init_val, nbytes );
+  
+  return ret;
+  
+} /* end get_eeprom */
+
+
+static int
+check_buttons (
+               const int  pad,
+               void      *udata
+               )
+{
+  return 0;
+} /* end check_buttons */
+
+
+static MD_Bool
+load_rom (
+          MD_Rom     *rom,
+          const char *fname
+          )
+{
+  
+  FILE *f;
+  long size;
+  
+  
+  f= fopen ( fname, "rb" );
+  if ( f == NULL ) return MD_FALSE;
+  if ( fseek ( f, 0, SEEK_END ) != 0 || (size= ftell ( f )) <= 0 ||
+       (size&0x1) || fseek ( f, 0, SEEK_SET ) != 0 )
+    {
+      fclose ( f );
+      return MD_FALSE;
+    }
+  rom->nwords= (int) (size/2);
+  MD_rom_alloc ( *rom );
+  if ( rom->bytes == NULL )
+    {
+      fclose ( f );
+      return MD_FALSE;
+    }
+  if ( fread ( rom->bytes, 1, size, f ) != (size_t) size )
+    {
+      MD_rom_free ( rom );
+      fclose ( f );
+      return MD_FALSE;
+    }
+  fclose ( f );
+  
+  return MD_rom_prepare ( rom ) == MD_NOERROR;
+  
+} /* end load_rom */
+
+
+
+
+/**********************/
+/* FUNCIONS PÚBLIQUES */
+/**********************/
+
+void
+MD_cpu_reset_external_devices_signal (void)
+{
+} /* end MD_cpu_reset_external_devices_signal */
+
+
+int
+main (
+      int   argc,
+      char *argv[]
+      )
+{
+  
+  MD_Rom rom;
+  MD_Frontend frontend;
+  long long ncc, cc, ninsts;
+  struct timespec t0, t1;
+  double secs;
+  
+  
+  if ( argc != 2 && argc != 3 )
+    {
+      fprintf ( stderr, "Ús: %s <rom> [<cicles>]\n", argv[0] );
+      return EXIT_FAILURE;
+    }
+  ncc= argc == 3 ? atoll ( argv[2] ) : NCC_DEF;
+  if ( !load_rom ( &rom, argv[1] ) )
+    {
+      fprintf ( stderr, "No s'ha pogut carregar '%s'\n", argv[1] );
+      return EXIT_FAILURE;
+    }
+  
+  memset ( &frontend, 0, sizeof(frontend) );
+  frontend.warning= warning;
+  frontend.sres_changed= sres_changed;
+  frontend.update_screen= update_screen;
+  frontend.play_sound= play_sound;
+  frontend.get_static_ram= get_static_ram;
+  frontend.get_eeprom= get_eeprom;
+  frontend.plugged_devs.dev1= MD_IODEV_PAD;
+  frontend.plugged_devs.dev2= MD_IODEV_PAD;
+  frontend.plugged_devs.dev_exp= MD_IODEV_NONE;
+  frontend.check_buttons= check_buttons;
+  MD_init ( &rom, MD_MODEL_OVERSEAS, &frontend, NULL );
+  
+  /* Mesura. */
+  cc= ninsts= 0;
+  clock_gettime ( CLOCK_MONOTONIC, &t0 );
+  while ( cc < ncc )
+    {
+      cc+= MD_cpu_run ();
+      ++ninsts;
+    }
+  clock_gettime ( CLOCK_MONOTONIC, &t1 );
+  secs= (double) (t1.tv_sec-t0.tv_sec) + (t1.tv_nsec-t0.tv_nsec)/1e9;
+  printf ( "%lld instruccions, %lld cicles, %.3f s, %.2f Minst/s\n",
+           ninsts, cc, secs, ninsts/secs/1e6 );
+  
+  MD_close ();
+  MD_rom_free ( &rom );
+  
+  return EXIT_SUCCESS;
+  
+} /* end main */
@@ -123,6 +123,7 @@ static struct
   int          width;
   int          height;
   SDL_Surface *surface;
+  int          native;    /* El VDP escriu directament en la surface. */
   
 } _screen;
 
@@ -334,23 +335,33 @@ update_screen (
   int i;
   
   
-  if ( _screen.surface == NULL ) return;
-  if ( SDL_MUSTLOCK ( _screen.surface ) )
-    SDL_LockSurface ( _screen.surface );
-  
-  data= _screen.surface->pixels;
-  for ( i= 0; i < _screen.width*_screen.height; ++i )
-    data[i]= _palette[fb[i]];
-  
-  if ( SDL_MUSTLOCK ( _screen.surface ) )
-    SDL_UnlockSurface ( _screen.surface );
+  if ( _screen.surface == NULL || MD_vdp_frame_skipped () ) return;
+  if ( !_screen.native )
+    {
+      if ( SDL_MUSTLOCK ( _screen.surface ) )
+        SDL_LockSurface ( _screen.surface );
+      
+      data= _screen.surface->pixels;
+      for ( i= 0; i < _screen.width*_screen.height; ++i )
+        data[i]= _palette[fb[i]];
+      
+      if ( SDL_MUSTLOCK ( _screen.surface ) )
+        SDL_UnlockSurface ( _screen.surface );
+    }
   
   if ( SDL_Flip ( _screen.surface ) == -1 )
     {
       fprintf ( stderr, "ERROR FATAL !!!: %s\n", SDL_GetError () );
+      MD_vdp_set_rgb_output ( MD_RGB_NONE, NULL, 0 );
       SDL_Quit ();
+      return;
     }
   
+  /* Amb doble buffer els píxels poden canviar després del flip. */
+  if ( _screen.native )
+    MD_vdp_set_rgb_output ( MD_RGB_XRGB8888, _screen.surface->pixels,
+        		    _screen.surface->pitch );
+  
 } /* end update_screen */
 
 
@@ -535,10 +546,24 @@ sres_changed (
   if ( _screen.surface == NULL )
     {
       fprintf ( stderr, "FATAL ERROR!!!: %s", SDL_GetError () );
+      MD_vdp_set_rgb_output ( MD_RGB_NONE, NULL, 0 );
       SDL_Quit ();
       return;
     }
   SDL_WM_SetCaption ( "MD", "MD" );
+  
+  /* Si el format de la surface coincidix amb XRGB8888 i no cal
+     bloquejar-la, el VDP escriu directament en ella. */
+  _screen.native=
+    !SDL_MUSTLOCK ( _screen.surface ) &&
+    _screen.surface->format->BytesPerPixel == 4 &&
+    _screen.surface->format->Rmask == 0x00FF0000 &&
+    _screen.surface->format->Gmask == 0x0000FF00 &&
+    _screen.surface->format->Bmask == 0x000000FF;
+  if ( _screen.native )
+    MD_vdp_set_rgb_output ( MD_RGB_XRGB8888, _screen.surface->pixels,
+        		    _screen.surface->pitch );
+  else MD_vdp_set_rgb_output ( MD_RGB_NONE, NULL, 0 );
  
 } /* end sres_changed */
 
@@ -814,6 +839,7 @@ MD_close_ (
   if ( !_initialized ) Py_RETURN_NONE;
 
   close_audio ();
+  MD_vdp_set_rgb_output ( MD_RGB_NONE, NULL, 0 );
   SDL_Quit ();
   if ( _rom.bytes != NULL ) MD_rom_free ( &_rom );
   if ( _sram != NULL ) free ( _sram );
@@ -913,6 +939,8 @@ MD_get_rom (
   
   PyObject *dict, *aux;
   MD_RomHeader header;
+  char *data;
+  int n;
   
   
   CHECK_INITIALIZED;
@@ -928,10 +956,12 @@ MD_get_rom (
     { Py_XDECREF ( aux ); goto error; }
   Py_XDECREF ( aux );
 
-  /* Bytes. */
-  aux= PyBytes_FromStringAndSize ( ((const char *) _rom.bytes),
-        			   _rom.nwords*2 );
+  /* Bytes. En l'ordre original (vore 'MD_BYTE_SWAP'). */
+  aux= PyBytes_FromStringAndSize ( NULL, _rom.nwords*2 );
   if ( aux == NULL ) goto error;
+  data= PyBytes_AS_STRING ( aux );
+  for ( n= 0; n < _rom.nwords*2; ++n )
+    data[n]= (char) _rom.bytes[n^MD_BYTE_SWAP];
   if ( PyDict_SetItemString ( dict, "bytes", aux ) == -1 )
     { Py_XDECREF ( aux ); goto error; }
   Py_XDECREF ( aux );
@@ -1230,6 +1260,31 @@ MD_loop_module (
 } /* end MD_loop_module */
 
 
+static PyObject *
+MD_run_frame_module (
+        	     PyObject *self,
+        	     PyObject *args
+        	     )
+{
+  
+  int n, ret;
+  
+  
+  CHECK_INITIALIZED;
+  CHECK_ROM;
+  if ( !PyArg_ParseTuple ( args, "i", &n ) )
+    return NULL;
+  
+  SDL_PauseAudio ( 0 );
+  ret= MD_run_frame ( n );
+  SDL_PauseAudio ( 1 );
+  if ( PyErr_Occurred () != NULL ) return NULL;
+  
+  return PyLong_FromLong ( ret );
+  
+} /* end MD_run_frame_module */
+
+
 static PyObject *
 MD_set_rom (
             PyObject *self,
@@ -1394,6 +1449,9 @@ static PyMethodDef MDMethods[]=
       "Save state into file" },
     { "loop", MD_loop_module, METH_VARARGS,
       "Run the simulator into a loop and block" },
+    { "run_frame", MD_run_frame_module, METH_VARARGS,
+      "Run the given number of frames and return the number of frames"
+      " actually run (fewer if the simulator was stopped)" },
     { "set_rom", MD_set_rom, METH_VARARGS,
       "Set a ROM into the simulator. The ROM should be of type bytes."
       " The second argument is a boolean: true/false (PAL/NTSC)"},
@@ -11,18 +11,18 @@ module= Extension ( 'MD',
                                '../src/io.c',
                                '../src/mem.c',
                                '../src/rom.c',
-                               '../src/unpack.c',
                                '../src/eeprom.c',
                                '../src/svp.c',
                                '../src/vdp.c',
+                               '../src/watch.c',
                                '../src/z80.c',
                                'Z80/src/z80.c',
                                'Z80/src/z80_dis.c'],
                     depends= [ '../src/MD.h',
-                               '../src/unpack.h',
                                'Z80/src/Z80.h' ],
                     libraries= [ 'SDL' ],
-                    define_macros= [('__LITTLE_ENDIAN__',None)],
+                    define_macros= [('__LITTLE_ENDIAN__',None),
+                                     ('MD_ROM_MMAP',None)],
                     include_dirs= [ '../src', 'Z80/src' ])
 
 setup ( name= 'MD',
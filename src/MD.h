@@ -90,6 +90,20 @@ typedef union
 } MD_Reg32;
 #endif
 
+/* Disposició de la memòria. La ROM (després de 'MD_rom_prepare'), la
+ * RAM de treball i la SRAM es guarden com a paraules de 16 bits en
+ * l'ordre de la màquina, de manera que una lectura de paraula és un
+ * accés directe. El byte de l'adreça A del bus es troba en l'índex
+ * A^MD_BYTE_SWAP del vector de bytes. La VRAM es guarda en l'ordre
+ * del bus (byte a byte) perquè el renderitzador la consumeix així, i
+ * la conversió es fa en el port de dades del VDP i en el DMA.
+ */
+#ifdef MD_LE
+#define MD_BYTE_SWAP 0x1
+#else /* MD_BE */
+#define MD_BYTE_SWAP 0x0
+#endif
+
 /* Funció per a emetre avísos. */
 typedef void 
 (MD_Warning) (
@@ -101,9 +115,25 @@ typedef void
 typedef enum
   {
     MD_NOERROR= 0,    /* No hi ha cap error. */
-    MD_EMEM           /* No hi ha prou memòria. */
+    MD_EMEM,          /* No hi ha prou memòria. */
+    MD_EFILE          /* Error en accedir a un fitxer. */
   } MD_Error;
 
+/* Mapa de pàgines modificades d'una memòria. El bit 'i' del mapa
+ * (bits[i>>6]>>(i&0x3F)) indica si s'ha escrit en la pàgina 'i', de
+ * 2^page_bits bytes, des de l'última vegada que es va netejar.
+ */
+typedef struct
+{
+  MDu64 *bits;        /* (npages+63)/64 paraules. */
+  int    npages;      /* Número de pàgines. */
+  int    page_bits;   /* Log2 de la grandària de pàgina en bytes. */
+} MD_DirtyMap;
+
+/* Marca com a modificada la pàgina PAGE d'un mapa de bits. */
+#define MD_DIRTY_SET(BITS,PAGE)        				\
+  ((BITS)[(PAGE)>>6]|= ((MDu64) 1)<<((PAGE)&0x3F))
+
 
 /*******/
 /* ROM */
@@ -115,11 +145,14 @@ typedef struct
 {
   
   int      nwords;    /* Número de paraules. */
-  MDu8    *bytes;     /* nwords*2. Dades originals de la ROM. */
+  MDu8    *bytes;     /* nwords*2. Dades originals de la ROM. Després
+        		 de 'MD_rom_prepare' estan en l'ordre de la
+        		 màquina (vore 'MD_BYTE_SWAP'). */
   
   /* No tocar esta part directament. */
-  MD_Word *words;     /* Paraules. */
+  MD_Word *words;     /* Paraules. Comparteix memòria amb 'bytes'. */
   MDu32    nbytes;    /* Número de bytes. */
+  MD_Bool  mapped;    /* 'bytes' prové de 'MD_rom_map'. */
   
 } MD_Rom;
 
@@ -165,35 +198,71 @@ typedef struct
   do {        						\
     ((ROM).bytes= (MDu8 *) malloc ( (ROM).nwords*2 ));        \
     (ROM).words= NULL;        				\
+    (ROM).mapped= MD_FALSE;        			\
   } while(0)
 
-/* Comprova que el checksum de la capçalera és correcte. */
+/* Comprova que el checksum de la capçalera és correcte. La ROM ha
+ * d'estar preparada.
+ */
 MD_Bool
 MD_rom_check_checksum (
         	       const MD_Rom *rom
         	       );
 
-/* Si s'ha reservat memòria en la ROM l'allibera. */
+/* Si s'ha reservat memòria en la ROM l'allibera. Si la ROM s'ha
+ * obtingut amb 'MD_rom_map' desfà la projecció.
+ */
 void
 MD_rom_free (
              MD_Rom *rom
              );
 
-/* Obté la capçalera d'una ROM. */
+/* Obté la capçalera d'una ROM. La ROM ha d'estar preparada. */
 void
 MD_rom_get_header (
         	   const MD_Rom *rom,
         	   MD_RomHeader *header
         	   );
 
+/* Projecta en memòria, de només lectura i compartida, una imatge de
+ * ROM ja preparada (vore 'MD_rom_save'). La ROM resultant està
+ * preparada i no s'ha de tornar a preparar. Com les pàgines són les
+ * de la memòria cau del sistema, totes les instàncies (d'este o
+ * d'altres processos) que projecten la mateixa imatge la
+ * comparteixen. La projecció necessita mmap i sols es fa si es
+ * compila amb MD_ROM_MMAP; en cas contrari la imatge es llig en
+ * memòria. S'ha d'alliberar amb 'MD_rom_free'. Torna MD_EFILE si no
+ * es pot llegir o la capçalera no correspon a una imatge d'esta
+ * màquina (ordre dels bytes o grandària) i MD_EMEM si no hi ha prou
+ * memòria.
+ */
+MD_Error
+MD_rom_map (
+            MD_Rom     *rom,
+            const char *fname
+            );
+
 /* Aquest funció prepara la ROM per a ser usada. Necessita que s'haja
- * carregat la ROM en bytes. Pot tornar MD_EMEM.
+ * carregat la ROM en bytes, que es reordenen sobre el mateix vector
+ * (no es fa cap còpia). Una ROM de 'MD_rom_map' ja està preparada i
+ * no es modifica. Pot tornar MD_EMEM.
  */
 MD_Error
 MD_rom_prepare (
         	MD_Rom *rom
         	);
 
+/* Guarda en un fitxer la imatge d'una ROM preparada, en l'ordre de
+ * la màquina, perquè es puga projectar amb 'MD_rom_map' sense tornar
+ * a preparar-la. La imatge comença amb una capçalera (identificador,
+ * ordre dels bytes i grandària). Pot tornar MD_EFILE.
+ */
+MD_Error
+MD_rom_save (
+             const MD_Rom *rom,
+             const char   *fname
+             );
+
 
 /**********/
 /* EEPROM */
@@ -323,12 +392,89 @@ MD_mem_read8 (
               const MDu32 addr    /* Adreça. */
               );
 
+/* Indica si l'adreça està mapejada en la ROM (a través del mapper del
+ * cartutx). La zona de la SRAM, quan està activa, no es considera ROM.
+ */
+MD_Bool
+MD_mem_is_rom (
+               const MDu32 addr
+               );
+
+/* Torna un punter a la regió de memòria (ROM o RAM) que conté
+ * l'adreça indicada, la qual es pot llegir directament mentre no
+ * canvie la configuració del mapper o de la SRAM. En 'start' i 'size'
+ * es tornen l'adreça inicial i la grandària en bytes de la
+ * regió. Torna NULL si l'adreça no és ROM ni RAM.
+ */
+const MD_Word *
+MD_mem_get_code_region (
+        		const MDu32  addr,
+        		MDu32       *start,
+        		MDu32       *size
+        		);
+
+/* Torna un punter per a llegir directament els 32K del bus que
+ * comencen en l'adreça indicada (alineada a 32K), o NULL si no són
+ * ROM o RAM o s'està en mode traça o amb punts de vigilància. Els
+ * bytes estan en l'ordre de MD_BYTE_SWAP. El punter deixa de ser
+ * vàlid quan es crida a MD_z80_update_bank.
+ */
+const MDu8 *
+MD_mem_get_bank_window (
+        		const MDu32 addr
+        		);
+
+/* Torna un punter per a escriure directament NBYTES en la RAM a
+ * partir de l'adreça indicada, o NULL si no estan tots en la mateixa
+ * còpia de la RAM o s'està en mode traça. Té els mateixos efectes
+ * que MD_mem_write (MD_mem_side_effects, invalidació del codi de la
+ * RAM), per tant sols s'ha de cridar quan es van a escriure tots els
+ * bytes.
+ */
+MD_Word *
+MD_mem_get_write_span (
+        	       const MDu32 addr,
+        	       const MDu32 nbytes
+        	       );
+
+/* Torna un comptador que s'incrementa amb cada escriptura i amb cada
+ * lectura fora de la RAM i la ROM (excepte l'estat de la VDP). Si
+ * no canvia entre dos instants cap accés a memòria ha tingut efectes
+ * laterals.
+ */
+MDu32
+MD_mem_side_effects (void);
+
+/* Torna un comptador que s'incrementa amb cada lectura de l'estat de
+ * la VDP. Aquestes lectures no compten en MD_mem_side_effects.
+ */
+MDu32
+MD_mem_vdp_status_reads (void);
+
+/* Marca la pàgina de RAM de l'adreça indicada com a pàgina amb codi
+ * descodificat pel processador. La següent escriptura en eixa pàgina
+ * invalidarà els blocs de la RAM (MD_cpu_invalidate_blocks).
+ */
+void
+MD_mem_set_ram_code (
+        	     const MDu32 addr
+        	     );
+
 /* Activa/Desactiva el mode traça en el mòdul de memòria. */
 void
 MD_mem_set_mode_trace (
         	       const MD_Bool val
         	       );
 
+/* Indica si hi ha punts de vigilància en el bus del 68000. Mentre
+ * n'hi haja cada accés comprova el mapa de 'MD_watch_get_map' i no
+ * es torna cap punter d'escriptura directa (MD_mem_get_write_span).
+ */
+void
+MD_mem_set_watch (
+        	  const MD_Bool val
+        	  );
+
 /* Escriu una paraula en l'adreça especificada. */
 void
 MD_mem_write (
@@ -357,6 +503,15 @@ MD_mem_load_state (
 const MD_Word *
 MD_mem_get_ram (void);
 
+/* Torna els mapes de pàgines modificades de la RAM i de la SRAM. Si
+ * no hi ha SRAM el seu mapa no té pàgines.
+ */
+void
+MD_mem_get_dirty (
+        	  MD_DirtyMap *ram,
+        	  MD_DirtyMap *sram
+        	  );
+
 
 /*******/
 /* I/O */
@@ -490,6 +645,14 @@ MD_io_load_state (
 /*******/
 /* Mòdul que simula el processador. */
 
+/* Camps de 3 bits de la paraula d'operació (bits 11-9, 8-6, 5-3 i
+ * 2-0). Els usen l'intèrpret i el desensamblador.
+ */
+#define MD_OPV3(OPWORD) ((MDu8) (((OPWORD)>>9)&0x7))
+#define MD_OPV2(OPWORD) ((MDu8) (((OPWORD)>>6)&0x7))
+#define MD_OPV1(OPWORD) ((MDu8) (((OPWORD)>>3)&0x7))
+#define MD_OPV0(OPWORD) ((MDu8) ((OPWORD)&0x7))
+
 /* Mnemonics. */
 typedef enum
   {
@@ -780,6 +943,30 @@ typedef struct
   
 } MD_Step;
 
+#ifdef MD_CPU_PROFILE
+/* Estadístiques d'execució d'un mnemònic. Sols existixen si es
+ * compila amb MD_CPU_PROFILE. Les lectures inclouen la paraula
+ * d'operació i les extensions. Cada accés al bus consumix 4 cicles,
+ * la resta de cicles es consideren de càlcul.
+ */
+typedef struct
+{
+  
+  MDu64 count;     /* Número d'execucions. */
+  MDu64 cc;        /* Cicles consumits. */
+  MDu64 reads;     /* Lectures de memòria. */
+  MDu64 writes;    /* Escriptures en memòria. */
+  
+} MD_CPUProfile;
+#endif
+
+/* Tipus de la funció que passa a la resta de xips els cicles que ha
+ * executat el processador dins de MD_cpu_run_until.
+ */
+typedef void (MD_CPUSync) (
+        		   const int cc
+        		   );
+
 /* Desactiva la senyal d'interrupció associat al auto-vector indicat. */
 void
 MD_cpu_clear_auto_vector_int (
@@ -814,6 +1001,39 @@ MD_cpu_init (
 void
 MD_cpu_init_state (void);
 
+/* Invalida els blocs de la memòria cau de blocs bàsics. Si ONLY_RAM
+ * és cert sols s'invaliden els blocs de la RAM, en cas contrari també
+ * es descarten les regions d'accés directe a memòria
+ * (MD_mem_get_code_region). El mòdul de memòria la crida quan
+ * s'escriu codi en la RAM o canvia el mapa de la ROM.
+ */
+void
+MD_cpu_invalidate_blocks (
+        		  const MD_Bool only_ram
+        		  );
+
+#ifdef MD_CPU_PROFILE
+/* Escriu en F el perfil d'execució en format CSV, una línia per
+ * mnemònic executat amb les columnes: mnemonic, count, cycles,
+ * mem_cycles, alu_cycles, reads i writes. Torna 0 si tot ha anat bé,
+ * -1 en cas contrari.
+ */
+int
+MD_cpu_profile_dump_csv (
+        		 FILE *f
+        		 );
+
+/* Torna el perfil d'execució del mnemònic indicat. */
+const MD_CPUProfile *
+MD_cpu_profile_get (
+        	    const MD_Mnemonic name
+        	    );
+
+/* Posa a 0 el perfil d'execució. */
+void
+MD_cpu_profile_reset (void);
+#endif
+
 /* Aquesta funció (no implementada) es cridada pel processador per a
  * resetejar els dispositus externs.
  */
@@ -826,6 +1046,18 @@ MD_cpu_reset_external_devices_signal (void);
 int
 MD_cpu_run (void);
 
+/* Executa instruccions fins que els cicles executats superen CC o fins
+ * que una instrucció accedix a un dispositiu. Abans de cada accés a un
+ * dispositiu (MD_cpu_sync) es crida a SYNC amb els cicles executats
+ * des de l'última sincronització, i la porció acaba després de la
+ * instrucció. Torna els cicles executats que no s'han passat a SYNC.
+ */
+int
+MD_cpu_run_until (
+        	  const int   cc,
+        	  MD_CPUSync *sync
+        	  );
+
 /* Activa la senyal d'interrupció associat al auto-vector indicat. */
 void
 MD_cpu_set_auto_vector_int (
@@ -833,10 +1065,59 @@ MD_cpu_set_auto_vector_int (
         				       vector. */
         		    );
 
+/* Activa/Desactiva la memòria cau de blocs bàsics. Quan està activa
+ * les instruccions de la ROM i la RAM es descodifiquen una única
+ * vegada per blocs i no es tornen a llegir les paraules d'operació
+ * de memòria. Per defecte està desactivada.
+ */
+void
+MD_cpu_set_block_cache (
+        		const MD_Bool enabled
+        		);
+
+/* Activa/Desactiva la detecció de bucles d'espera. Quan està activa,
+ * si una iteració d'un bucle acaba amb un salt cap arrere sense
+ * modificar cap registre ni tindre efectes laterals en memòria
+ * (MD_mem_side_effects), el processador avança directament les
+ * iteracions que caben fins al següent esdeveniment de la VDP. Els
+ * bucles que sols llegeixen l'estat de la VDP
+ * (MD_mem_vdp_status_reads) també s'avancen, però com a molt fins
+ * que l'estat puga canviar (MD_vdp_cc_to_status_change). Per defecte
+ * està desactivada.
+ */
+void
+MD_cpu_set_idle_skip (
+        	      const MD_Bool enabled
+        	      );
+
+/* Activa/Desactiva el mode traça en el processador. En mode traça
+ * no es gasta la memoria cau de blocs.
+ */
+void
+MD_cpu_set_mode_trace (
+        	       const MD_Bool val
+        	       );
+
+/* Indica si hi ha punts de vigilància en el bus del 68000. Mentre
+ * n'hi haja les dades no es lligen directament de la ROM/RAM i no es
+ * boten bucles d'espera.
+ */
+void
+MD_cpu_set_watch (
+        	  const MD_Bool val
+        	  );
+
 /* Activa la senyal de RESET del processador. */
 void
 MD_cpu_set_reset (void);
 
+/* El mòdul de memòria la crida abans d'accedir a un dispositiu. Dins
+ * de MD_cpu_run_until passa a la resta de xips els cicles pendents, i
+ * fora no fa res.
+ */
+void
+MD_cpu_sync (void);
+
 int
 MD_cpu_save_state (
         	   FILE *f
@@ -886,12 +1167,25 @@ MD_z80_busreq_write (
         	     const MDu8 data
         	     );
 
+/* Indica si el Z80 pot modificar l'estat del 68000 escrivint a través
+ * de la finestra del banc, és a dir, si està en marxa i el banc no
+ * apunta a la ROM.
+ */
+MD_Bool
+MD_z80_can_modify_68k (void);
+
 /* Procesa cicles de la UCP (rellotge). */
 void
 MD_z80_clock (
               const int cc
               );
 
+/* Torna el mapa de pàgines modificades de la RAM del Z80. */
+void
+MD_z80_get_dirty (
+        	  MD_DirtyMap *ram
+        	  );
+
 /* Inicialitza el Z80. */
 void
 MD_z80_init (
@@ -916,6 +1210,42 @@ MD_z80_reset (
               const MDu8 data
               );
 
+/* Activa/Desactiva la detecció de bucles d'espera del Z80. Quan està
+ * activa, si les iteracions d'un bucle no tenen efectes laterals
+ * (sols lligen la seua RAM, l'estat del FM o la finestra del banc) i
+ * sols executen instruccions que deixen els registres en el mateix
+ * estat (càrregues, AND, OR, CP, BIT i salts), es boten les
+ * iteracions que caben en els cicles pendents. El registre R no
+ * avança durant les iteracions botades. El bucle continua en
+ * espera en les següents crides a MD_z80_clock fins que el 68000
+ * escriu en l'àrea del Z80, canvia la senyal d'interrupció o l'estat
+ * del FM. No té efecte en mode traça ni amb punts de vigilància. Per
+ * defecte està desactivada.
+ */
+void
+MD_z80_set_idle_skip (
+        	      const MD_Bool enabled
+        	      );
+
+/* Activa/Desactiva la senyal d'interrupció del Z80 (VDP). */
+void
+MD_z80_set_int (
+        	const MD_Bool active
+        	);
+
+/* Torna a calcular el punter de la finestra del banc
+ * (MD_mem_get_bank_window). El mòdul de memòria la crida quan canvia
+ * el mapa de memòria o les funcions d'accés del 68000.
+ */
+void
+MD_z80_update_bank (void);
+
+/* Indica si hi ha punts de vigilància en el bus del Z80. */
+void
+MD_z80_set_watch (
+        	  const MD_Bool val
+        	  );
+
 /* Fa el mateix que MD_z80_clock però cridant a les funcions de
  * callback.
  */
@@ -959,6 +1289,14 @@ typedef void (MD_UpdateScreen) (
         			void      *udata
         			);
 
+/* Formats d'eixida RGB directa (vore MD_vdp_set_rgb_output). */
+typedef enum
+  {
+    MD_RGB_NONE= 0,     /* Sols FB de 'MD_UpdateScreen'. */
+    MD_RGB_XRGB8888,    /* Paraules de 32 bits 0x00RRGGBB. */
+    MD_RGB_RGB565       /* Paraules de 16 bits RRRRRGGGGGGBBBBB. */
+  } MD_RGBFormat;
+
 /* Indica a la VDP que una interrupció ha sigut servida. Al cridar a
  * aquesta funció la VDP no li diu res a la UCP.
  */
@@ -967,6 +1305,20 @@ MD_vdp_clear_interrupt (
         		const int priority 
         		);
 
+/* Torna els cicles de CPU que es poden processar amb MD_vdp_clock
+ * abans del següent esdeveniment de la VDP (interrupcions, final de
+ * frame, línia, ...). Si està fent DMA torna 0.
+ */
+int
+MD_vdp_cc_to_next_event (void);
+
+/* Torna els cicles de CPU que es poden processar abans que puga
+ * canviar el valor tornat per MD_vdp_status (HBlank, VBlank, flags
+ * dels sprites, VInt, ...). Si està fent DMA torna 0.
+ */
+int
+MD_vdp_cc_to_status_change (void);
+
 /* Processa cicles de CPU. Torna si està ocupat fent DMA mem->vram o
    no. */
 MD_Bool
@@ -1010,6 +1362,16 @@ MD_vdp_dma_mem2vram_step (void);
 const MDu16 *
 MD_vdp_get_cram (void);
 
+/* Torna els mapes de pàgines modificades de la VRAM, la CRAM i la
+ * VSRAM. Les adreces són les del port de dades del VDP.
+ */
+void
+MD_vdp_get_dirty (
+        	  MD_DirtyMap *vram,
+        	  MD_DirtyMap *cram,
+        	  MD_DirtyMap *vsram
+        	  );
+
 /* Torna un punter a la memòria de vídeo. La grandària és 65536. */
 const MDu8 *
 MD_vdp_get_vram (void);
@@ -1059,6 +1421,43 @@ MD_vdp_set_dma_lag (
                     const int lag
                     );
 
+// Mode de bot de frames per a simulacions sense pantalla. Es boten N
+// frames i es dibuixa el següent, si N és 0 es dibuixen tots i si és
+// negatiu sols es dibuixen els demanats amb MD_vdp_request_frame. Els
+// frames botats no modifiquen el frame buffer però mantenen el timing,
+// les interrupcions i els flags de sprites, i es crida igualment al
+// callback 'update_screen' (MD_vdp_frame_skipped indica si el frame
+// s'ha botat). Es decideix al principi de cada frame.
+void
+MD_vdp_set_frame_skip (
+                       const int n
+                       );
+
+// Dins del callback 'update_screen' indica si el frame que s'acaba de
+// completar s'ha botat, és a dir, si el FB (o el buffer de
+// MD_vdp_set_rgb_output) no s'ha actualitzat.
+MD_Bool
+MD_vdp_frame_skipped (void);
+
+// Força que es dibuixe el següent frame.
+void
+MD_vdp_request_frame (void);
+
+// Fa que el VDP escriga cada línia directament en BUF en el format
+// indicat, amb PITCH bytes per fila, en compte d'escriure el FB de
+// 'MD_UpdateScreen' (que deixa d'actualitzar-se). BUF ha de tindre
+// espai per a la resolució indicada per 'MD_SResChanged' i es pot
+// canviar en qualsevol moment, per exemple dins de 'update_screen'.
+// Amb MD_RGB_NONE o BUF a NULL es torna al FB. Els colors es
+// converteixen amb MD_color2rgb i es recalculen sols quan es modifica
+// la CRAM.
+void
+MD_vdp_set_rgb_output (
+                       const MD_RGBFormat  format,
+                       void               *buf,
+                       const int           pitch
+                       );
+
 
 /******/
 /* FM */
@@ -1383,6 +1782,121 @@ MD_svp_load_state (
         	   FILE *f
         	   );
 
+/* Indica si hi ha punts de vigilància en el bus extern del SVP. */
+void
+MD_svp_set_watch (
+        	  const MD_Bool val
+        	  );
+
+
+/*********/
+/* WATCH */
+/*********/
+/* Punts de vigilància sobre rangs d'adreces dels busos. Són una
+ * alternativa al mode traça: sols es crida al 'frontend' quan un
+ * accés cau dins d'un rang, i mentre no hi ha punts en un bus eixe
+ * bus no paga res. Els accessos de dades (incloent el DMA i la
+ * finestra del Z80 sobre el bus del 68000) es comproven sempre; les
+ * lectures d'instruccions des de ROM/RAM no. En mode traça no es
+ * comproven.
+ */
+
+/* Número màxim de punts de vigilància. */
+#define MD_WATCH_MAX 64
+
+/* Log2 de la grandària (en unitats del bus) de les pàgines dels
+ * mapes.
+ */
+#define MD_WATCH_PAGE_BITS 8
+
+/* Comprova el bit de la pàgina de l'adreça en un mapa. */
+#define MD_WATCH_TEST(MAP,ADDR)        				\
+  (((MAP)[(ADDR)>>(MD_WATCH_PAGE_BITS+6)]>>        		\
+    (((ADDR)>>MD_WATCH_PAGE_BITS)&0x3F))&0x1)
+
+/* Busos. Les adreces del 68000 i del Z80 són en bytes, les del SVP
+ * en paraules del bus extern.
+ */
+typedef enum
+  {
+    MD_WATCH_68K= 0,
+    MD_WATCH_Z80,
+    MD_WATCH_SVP
+  } MD_WatchBus;
+
+/* Tipus d'accés a vigilar. */
+enum
+  {
+    MD_WATCH_READ= 0x1,
+    MD_WATCH_WRITE= 0x2
+  };
+
+/* Tipus de la funció que es crida quan un accés cau dins d'un punt
+ * de vigilància. En accessos de paraula del 68000 'addr' és
+ * l'adreça de la paraula.
+ */
+typedef void (MD_WatchHit) (
+        		    const int               id,   /* Punt. */
+        		    const MD_WatchBus       bus,  /* Bus. */
+        		    const MD_MemAccessType  type, /* Tipus */
+        		    const MDu32             addr, /* Adreça */
+        		    const MDu16             data, /* Dades */
+        		    void                   *udata
+        		    );
+
+/* Afegix un punt de vigilància sobre el rang [begin,end] del bus
+ * indicat. KINDS és una combinació de MD_WATCH_READ i
+ * MD_WATCH_WRITE. Torna l'identificador o -1 si no queden punts
+ * lliures o els paràmetres no són vàlids.
+ */
+int
+MD_watch_add (
+              const MD_WatchBus bus,
+              const MDu32       begin,
+              const MDu32       end,
+              const int         kinds
+              );
+
+/* Comprova els rangs exactes d'un accés que ha caigut en una pàgina
+ * marcada i crida al 'frontend'. SIZE és el número d'unitats del
+ * bus que ocupa l'accés.
+ */
+void
+MD_watch_check (
+        	const MD_WatchBus       bus,
+        	const MD_MemAccessType  type,
+        	const MDu32             addr,
+        	const int               size,
+        	const MDu16             data
+        	);
+
+/* Elimina tots els punts de vigilància. */
+void
+MD_watch_clear (void);
+
+/* Torna el mapa de pàgines amb punts de vigilància d'un bus per al
+ * tipus d'accés indicat, o NULL si el bus no existeix. El punter no
+ * canvia.
+ */
+const MDu64 *
+MD_watch_get_map (
+        	  const MD_WatchBus      bus,
+        	  const MD_MemAccessType type
+        	  );
+
+/* Inicialitza el mòdul sense cap punt de vigilància. */
+void
+MD_watch_init (
+               MD_WatchHit *hit,
+               void        *udata
+               );
+
+/* Elimina un punt de vigilància. */
+void
+MD_watch_remove (
+        	 const int id
+        	 );
+
 
 /********/
 /* MAIN */
@@ -1438,6 +1952,9 @@ typedef struct
         				 UCP Z80. */
   MD_CPUStepSVP   *cpu_step_svp;      // Es crida en cada pasr de la
                                       // UCP SVP.
+  MD_WatchHit     *watch_hit;         /* Es crida quan un accés cau
+        				 dins d'un punt de vigilància
+        				 (MD_watch_add). */
   
 } MD_TraceCallbacks;
 
@@ -1504,6 +2021,25 @@ typedef struct
   MDu8 r,g,b;
 } MD_RGB;
 
+/* Memòries amb seguiment de pàgines modificades. */
+typedef enum
+  {
+    MD_DIRTY_RAM= 0,    /* RAM del 68000. Pàgines de 256 bytes. */
+    MD_DIRTY_Z80_RAM,   /* RAM del Z80. Pàgines de 256 bytes. */
+    MD_DIRTY_VRAM,      /* VRAM. Pàgines de 32 bytes (un patró). */
+    MD_DIRTY_CRAM,      /* CRAM. Pàgines de 32 bytes (una paleta). */
+    MD_DIRTY_VSRAM,     /* VSRAM. Pàgines de 4 bytes (una columna). */
+    MD_DIRTY_SRAM       /* SRAM. Pàgines de 256 bytes. */
+  } MD_DirtyRegion;
+
+/* Marca totes les pàgines de la memòria indicada com a no
+ * modificades.
+ */
+void
+MD_clear_dirty (
+        	const MD_DirtyRegion region
+        	);
+
 /* Allibera memòria de la llibreria. */
 void
 MD_close (void);
@@ -1515,6 +2051,19 @@ MD_color2rgb (
               const int color
               );
 
+/* Obté el mapa de pàgines modificades de la memòria indicada. El mapa
+ * apunta a memòria de la llibreria, és vàlid fins a 'MD_close' i no
+ * s'ha de modificar. Les escriptures des de qualsevol camí (UCP,
+ * Z80, DMA, ports del VDP) marquen la pàgina, i 'MD_init' i
+ * 'MD_load_state' marquen totes les pàgines (la SRAM sols en
+ * 'MD_load_state').
+ */
+void
+MD_get_dirty (
+              const MD_DirtyRegion  region,
+              MD_DirtyMap          *map
+              );
+
 /* Torna en devs els dispositius actualment conectats. Si no està
  * inicialitzat no fa res.
  */
@@ -1536,10 +2085,16 @@ MD_init (
         				       'frontend'. */
          );
 
-/* Executa un cicle de la Mega Drive. Aquesta funció executa una
- * iteració de 'MD_loop' i torna els cicles de UCP emprats. Si
- * CHECKSIGNALS en el frontend no és NULL aleshores cada cert temps al
- * cridar a MD_iter es fa una comprovació de CHECKSIGNALS.  La funció
+/* Executa una porció de la Mega Drive: el processador executa
+ * instruccions (MD_cpu_run_until) fins al següent esdeveniment
+ * planificat (VDP, Z80, CHECKSIGNALS), com a molt una línia (488
+ * cicles), o fins que una instrucció accedix a un dispositiu, i
+ * després la resta de xips es posen al dia. Si el Z80 pot modificar
+ * la memòria del 68000 la porció és d'una instrucció. Torna els
+ * cicles de UCP de tota la porció, inclosos els que ja s'han passat
+ * als xips en els accessos a dispositius. Si CHECKSIGNALS en el
+ * frontend no és NULL aleshores cada cert temps al cridar a MD_iter
+ * es fa una comprovació de CHECKSIGNALS.  La funció
  * CHECKSIGNALS del frontend es crida amb una freqüència suficient per
  * a que el frontend tracte els seus events. La senyal stop de
  * CHECKSIGNALS és llegit en STOP si es crida a CHECKSIGNALS.
@@ -1592,7 +2147,20 @@ MD_set_io_devs (
         	const MD_IOPluggedDevices devs
         	);
 
-/* Para a 'MD_loop'. */
+/* Executa N frames sencers i torna just després de que la VDP cride
+ * a UPDATE_SCREEN per a l'últim. Igual que en MD_iter, si
+ * CHECKSIGNALS no és NULL es crida cada cert temps. Torna el número
+ * de frames executats, que és menor que N si s'ha parat mitjançant
+ * CHECKSIGNALS o MD_stop. Una petició de MD_reset s'atén abans de
+ * continuar executant. Si N és menor o igual que 0 no fa res i torna
+ * 0.
+ */
+int
+MD_run_frame (
+              const int n
+              );
+
+/* Para a 'MD_loop' o a 'MD_run_frame'. */
 void
 MD_stop (void);
 
@@ -28,7 +28,6 @@
 #include <string.h>
 
 #include "MD.h"
-#include "unpack.h"
 
 
 
@@ -46,7 +45,10 @@
 
 /* General. */
 #define UTIME 4
-#define CLEAR_FLAGS(FLAGS) _regs.CCR.v&= ((FLAGS)^0xFFFF)
+#define CLEAR_FLAGS(FLAGS) SREG.v&= ((FLAGS)^0xFFFF)
+
+/* Registre d'estat amb els flags pendents ja calculats. */
+#define SREG (*sreg ())
 
 /* General. */
 #define C1B(VAL) ((MDu8) (~(VAL)))
@@ -68,6 +70,107 @@
 #define IBITS (T1FLAG|SFLAG|I2FLAG|I1FLAG|I0FLAG|XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG)
 #define IBITS_CCR (XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG)
 
+/* Memòria cau de blocs bàsics. */
+#define BC_MAP_SIZE 4096
+#define BC_NBLOCKS  4096
+#define BC_NOPS     32768
+#define BC_MAX_OPS  64
+
+/* Màxim de cicles que es boten d'una vegada en un bucle d'espera
+ * (aproximadament una línia). La resta de xips es processen de colp,
+ * i si el salt és massa gran el Z80 s'avança massa respecte al FM.
+ */
+#define IDLE_MAX_CC 488
+
+/* Número de registres d'una màscara de MOVEM. */
+#define MOVEM_NREGS(MASK) ((MDu32) __builtin_popcount ( (MASK).v ))
+
+/* Perfil d'execució. */
+#ifdef MD_CPU_PROFILE
+#define PROF_NNAMES ((int) MD_UNLK + 1)
+#define PROF_BUS_CC 4 /* Cicles de cada accés al bus. */
+#endif
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+typedef MDu8 (opb_t) (MDu8 const a,MDu8 const b);
+typedef MD_Word (opw_t) (MD_Word const a,MD_Word const b);
+typedef MD_Reg32 (opl_t) (MD_Reg32 const a,MD_Reg32 const b);
+typedef MDu32 (op_t) (const MDu32 a,const MDu32 b);
+typedef MDu8 (sopb_t) (MDu8 const val,unsigned int count);
+typedef MD_Word (sopw_t) (MD_Word const val,unsigned int count);
+typedef MD_Reg32 (sopl_t) (MD_Reg32 const val,unsigned int count);
+typedef int (bop_mem_t) (MDu32 const addr,int const bit);
+typedef int (bop_reg_t) (MDu8 const reg,int const bit);
+typedef int (inst_t) (MDu8 const v3,MDu8 const v2,MDu8 const v1,MDu8 const v0);
+
+/* Operacions amb els flags pendents de calcular. Les operacions a
+ * partir de LF_ADDB també modifiquen el flag X.
+ */
+typedef enum
+  {
+    LF_NONE= 0,
+    LF_LOGB,
+    LF_LOGW,
+    LF_LOGL,
+    LF_CMPB,
+    LF_CMPW,
+    LF_CMPL,
+    LF_ADDB,
+    LF_ADDW,
+    LF_ADDL,
+    LF_SUBB,
+    LF_SUBW,
+    LF_SUBL
+  } lf_op_t;
+
+/* Memòria cau de blocs bàsics. Un bloc és una seqüència
+ * d'instruccions consecutives ja descodificades que comença en una
+ * adreça concreta. Cada instrucció guarda directament el seu gestor
+ * (codi enfilat) i cada bloc recorda els últims blocs que l'han
+ * seguit per a no haver de buscar-los en la taula.
+ */
+typedef struct
+{
+  MDu32   pc;             /* Adreça de la instrucció. */
+  MDu8    v3,v2,v1,v0;    /* Camps de la paraula d'operació. */
+  inst_t *f;              /* Gestor. */
+} bc_op_t;
+
+typedef struct bc_block bc_block_t;
+
+struct bc_block
+{
+  MDu32       pc;         /* Adreça inicial. */
+  bc_op_t    *ops;        /* Instruccions. */
+  int         nops;
+  MD_Bool     in_ram;
+  bc_block_t *succ[2];    /* Últims successors (del mateix conjunt). */
+};
+
+/* Conjunt de blocs que s'invaliden junts. */
+typedef struct
+{
+  bc_block_t *map[BC_MAP_SIZE];      /* Indexat per (pc>>1). */
+  bc_block_t  blocks[BC_NBLOCKS];
+  int         nblocks;
+  bc_op_t     ops[BC_NOPS];
+  int         nops;
+} bc_pool_t;
+
+/* Regió de ROM o RAM accessible directament (MD_mem_get_code_region). */
+typedef struct
+{
+  const MD_Word *words;  /* Paraula de l'adreça 'start'. */
+  MDu32          start;
+  MDu32          size;   /* En bytes. 0 si no hi ha regió vàlida. */
+} region_t;
+
 
 
 
@@ -92,28 +195,134 @@ static struct
   
 } _regs;
 
+/* Registres en l'ordre de la màscara de MOVEM. */
+static MD_Reg32 * const _movem_regs[16]=
+  {
+    &(_regs.D[0]), &(_regs.D[1]), &(_regs.D[2]), &(_regs.D[3]),
+    &(_regs.D[4]), &(_regs.D[5]), &(_regs.D[6]), &(_regs.D[7]),
+    &(_regs.A[0]), &(_regs.A[1]), &(_regs.A[2]), &(_regs.A[3]),
+    &(_regs.A[4]), &(_regs.A[5]), &(_regs.A[6]), &(_regs.A[7])
+  };
+
+/* Última operació que ha modificat els flags. Els flags sols es
+ * calculen quan algú llig o modifica el registre d'estat.
+ */
+static struct
+{
+  
+  lf_op_t op;
+  MDu32   src;
+  MDu32   dst;
+  MDu32   res;
+  
+} _lf;
+
 /* Interrupcions. */
 static MDu32 _ints;    /* Bits: 1->RESET, 2-8->AUTO_VEC[1..7]. */
 
 /* Per a la instrucció STOP. */
 static MD_Bool _stop;
 
+/* Taula de bot: gestor de cada paraula d'operació. Els camps es
+ * trauen directament de la paraula (MD_OPV3..MD_OPV0).
+ */
+static inst_t *_insts[0x10000];
 
+/* Memòria cau de blocs bàsics. Els blocs de la ROM sols s'invaliden
+ * quan canvia el mapa de memòria, els de la RAM quan s'escriu en una
+ * pàgina amb codi.
+ */
+static struct
+{
+  
+  MD_Bool        enabled;
+  MD_Bool        trace;    /* En mode traça no es gasta. */
+  bc_block_t    *block;    /* Bloc actual. */
+  const bc_op_t *cur;      /* Següent instrucció del bloc actual. */
+  const bc_op_t *end;
+  bc_pool_t      rom;
+  bc_pool_t      ram;
+  
+} _bc;
 
+/* Detecció de bucles d'espera. */
+static struct
+{
+  
+  MD_Bool  enabled;
+  MDu32    cc;           /* Cicles executats. */
+  MDu32    pc;           /* Inici del bucle candidat. */
+  MDu32    cc_start;     /* Valor de 'cc' en l'última iteració. */
+  MDu32    side_effects; /* Valor de MD_mem_side_effects. */
+  MDu32    status_reads; /* Valor de MD_mem_vdp_status_reads. */
+  MD_Reg32 D[8];
+  MD_Reg32 A[8];
+  MD_Reg32 USP;          /* Còpia de _regs._SP. */
+  MDu16    CCR;
+  
+} _idle;
 
-/*********/
-/* TIPUS */
-/*********/
+/* Execució per porcions (MD_cpu_run_until). */
+static struct
+{
+  
+  MD_CPUSync *sync;      /* NULL fora de MD_cpu_run_until. */
+  int         cc;        /* Cicles pendents de sincronitzar. */
+  MD_Bool     stop;      /* Acaba després de la instrucció actual. */
+  
+} _slice;
 
-typedef MDu8 (opb_t) (MDu8 const a,MDu8 const b);
-typedef MD_Word (opw_t) (MD_Word const a,MD_Word const b);
-typedef MD_Reg32 (opl_t) (MD_Reg32 const a,MD_Reg32 const b);
-typedef MDu32 (op_t) (const MDu32 a,const MDu32 b);
-typedef MDu8 (sopb_t) (MDu8 const val,unsigned int count);
-typedef MD_Word (sopw_t) (MD_Word const val,unsigned int count);
-typedef MD_Reg32 (sopl_t) (MD_Reg32 const val,unsigned int count);
-typedef int (bop_mem_t) (MDu32 const addr,int const bit);
-typedef int (bop_reg_t) (MDu8 const reg,int const bit);
+/* Regions de memòria d'on es llegeixen les instruccions i les
+ * últimes dades.
+ */
+static region_t _fetch;
+static region_t _data;
+
+/* Hi ha punts de vigilància en el bus. Les dades sempre es lligen
+ * amb MD_mem_read.
+ */
+static MD_Bool _watch;
+
+#ifdef MD_CPU_PROFILE
+/* Perfil d'execució per mnemònic. */
+static struct
+{
+  
+  MD_CPUProfile insts[PROF_NNAMES];
+  int           names[0x10000]; /* Mnemònic de cada paraula
+        			   d'operació. -1 si no es coneix. */
+  MD_Mnemonic   name;           /* Instrucció actual. */
+  MDu64         reads;          /* Lectures de la instrucció actual. */
+  MDu64         writes;         /* Escriptures de la instrucció actual. */
+  
+} _prof;
+
+static const char * const _prof_names[PROF_NNAMES]=
+  {
+    "UNK", "ABCD", "ADDb", "ADDw", "ADDl", "ADDIb", "ADDIw", "ADDIl",
+    "ADDQb", "ADDQl", "ADDQw", "ADDXb", "ADDXw", "ADDXl", "ANDb", "ANDw",
+    "ANDl", "ANDIb", "ANDIw", "ANDIl", "ASLb", "ASLw", "ASLl", "ASRb",
+    "ASRw", "ASRl", "BCC", "BCS", "BEQ", "BGE", "BGT", "BHI", "BLE",
+    "BLS", "BLT", "BMI", "BNE", "BPL", "BVC", "BVS", "BCHG", "BCLR",
+    "BRA", "BSET", "BSR", "BTST", "CHK", "CLRb", "CLRw", "CLRl", "CMPb",
+    "CMPw", "CMPl", "CMPIb", "CMPIw", "CMPIl", "CMPMb", "CMPMw", "CMPMl",
+    "DBCC", "DBCS", "DBEQ", "DBF", "DBGE", "DBGT", "DBHI", "DBLE",
+    "DBLS", "DBLT", "DBMI", "DBNE", "DBPL", "DBT", "DBVC", "DBVS",
+    "DIVS", "DIVU", "EORb", "EORw", "EORl", "EORIb", "EORIw", "EORIl",
+    "EXG", "EXTl", "EXTw", "ILLEGAL", "JMP", "JSR", "LEA", "LINK",
+    "LSLb", "LSLw", "LSLl", "LSRb", "LSRw", "LSRl", "MOVEb", "MOVEw",
+    "MOVEl", "MOVEMl", "MOVEMw", "MOVEPw", "MOVEPl", "MOVEQ", "MULS",
+    "MULU", "NBCD", "NEGb", "NEGl", "NEGw", "NEGXb", "NEGXl", "NEGXw",
+    "NOP", "NOTb", "NOTl", "NOTw", "ORb", "ORl", "ORw", "ORIb", "ORIl",
+    "ORIw", "PEA", "RESET", "ROLb", "ROLw", "ROLl", "RORb", "RORw",
+    "RORl", "ROXLb", "ROXLw", "ROXLl", "ROXRb", "ROXRw", "ROXRl", "RTE",
+    "RTR", "RTS", "SBCD", "SCC", "SCS", "SEQ", "SF", "SGE", "SGT", "SHI",
+    "SLE", "SLS", "SLT", "SMI", "SNE", "SPL", "ST", "SVC", "SVS", "STOP",
+    "SUBb", "SUBw", "SUBl", "SUBIb", "SUBIw", "SUBIl", "SUBQb", "SUBQl",
+    "SUBQw", "SUBXb", "SUBXl", "SUBXw", "SWAP", "TRAP", "TSTb", "TSTw",
+    "TSTl", "UNLK"
+  };
+#endif
 
 
 
@@ -122,6 +331,398 @@ typedef int (bop_reg_t) (MDu8 const reg,int const bit);
 /* FUNCIONS PRIVADES */
 /*********************/
 
+#ifdef MD_CPU_PROFILE
+/* Perfil d'execució **********************************************************/
+/* Tots els accessos a memòria del processador passen per ací. */
+static MD_Word
+prof_mem_read (
+               const MDu32 addr
+               )
+{
+  
+  ++_prof.reads;
+  
+  return MD_mem_read ( addr );
+  
+} /* end prof_mem_read */
+
+
+static MDu8
+prof_mem_read8 (
+        	const MDu32 addr
+        	)
+{
+  
+  ++_prof.reads;
+  
+  return MD_mem_read8 ( addr );
+  
+} /* end prof_mem_read8 */
+
+
+static void
+prof_mem_write (
+        	const MDu32   addr,
+        	const MD_Word data
+        	)
+{
+  
+  ++_prof.writes;
+  MD_mem_write ( addr, data );
+  
+} /* end prof_mem_write */
+
+
+static void
+prof_mem_write8 (
+        	 const MDu32 addr,
+        	 const MDu8  data
+        	 )
+{
+  
+  ++_prof.writes;
+  MD_mem_write8 ( addr, data );
+  
+} /* end prof_mem_write8 */
+
+#define MD_mem_read prof_mem_read
+#define MD_mem_read8 prof_mem_read8
+#define MD_mem_write prof_mem_write
+#define MD_mem_write8 prof_mem_write8
+
+
+/* Identifica la instrucció que es va a executar. Sols es descodifica
+ * la primera vegada que apareix cada paraula d'operació, i sols si
+ * està en ROM o RAM per a no provocar accessos a dispositius.
+ */
+static void
+prof_begin (
+            const MD_Bool cached
+            )
+{
+  
+  const MD_Word *words;
+  MDu32 start, size;
+  MDu16 opword;
+  MD_Inst inst;
+  
+  
+  words= MD_mem_get_code_region ( _regs.PC, &start, &size );
+  if ( words == NULL || (_regs.PC&0xFFFFFF)-start >= size )
+    _prof.name= MD_UNK;
+  else
+    {
+      opword= words[((_regs.PC&0xFFFFFF)-start)>>1].v;
+      if ( _prof.names[opword] == -1 )
+        {
+          MD_cpu_decode ( _regs.PC, &inst );
+          _prof.names[opword]= (int) inst.id.name;
+        }
+      _prof.name= (MD_Mnemonic) _prof.names[opword];
+    }
+  
+  /* La memòria cau de blocs no torna a llegir la paraula
+     d'operació, però el processador sí. */
+  _prof.reads= cached ? 1 : 0;
+  _prof.writes= 0;
+  
+} /* end prof_begin */
+
+
+static void
+prof_end (
+          const int cc
+          )
+{
+  
+  MD_CPUProfile *p;
+  
+  
+  p= &(_prof.insts[_prof.name]);
+  ++p->count;
+  p->cc+= (MDu64) cc;
+  p->reads+= _prof.reads;
+  p->writes+= _prof.writes;
+  
+} /* end prof_end */
+#endif
+
+
+/* Flags mandrosos ************************************************************/
+static void
+sync_flags (void)
+{
+  
+  MDu32 a, b, r, neg;
+  MDu16 flags, mask;
+  
+  
+  a= _lf.dst; b= _lf.src; r= _lf.res;
+  switch ( _lf.op )
+    {
+    case LF_LOGB:
+      mask= NFLAG|ZFLAG|VFLAG|CFLAG;
+      flags= ((r&0xFF)?0:ZFLAG) | ((r&0x80)?NFLAG:0);
+      break;
+    case LF_LOGW:
+      mask= NFLAG|ZFLAG|VFLAG|CFLAG;
+      flags= ((r&0xFFFF)?0:ZFLAG) | ((r&0x8000)?NFLAG:0);
+      break;
+    case LF_LOGL:
+      mask= NFLAG|ZFLAG|VFLAG|CFLAG;
+      flags= (r?0:ZFLAG) | ((r&0x80000000)?NFLAG:0);
+      break;
+    case LF_CMPB:
+      neg= C1B(b);
+      mask= NFLAG|ZFLAG|VFLAG|CFLAG;
+      flags=
+        (((~r)&0x100)?CFLAG:0) |
+        (((~(neg^a))&(r^neg)&0x80)?VFLAG:0) |
+        ((r&0xFF)?0:ZFLAG) |
+        ((r&0x80)?NFLAG:0);
+      break;
+    case LF_CMPW:
+      neg= C1W(b);
+      mask= NFLAG|ZFLAG|VFLAG|CFLAG;
+      flags=
+        (((~r)&0x10000)?CFLAG:0) |
+        (((~(neg^a))&(r^neg)&0x8000)?VFLAG:0) |
+        ((r&0xFFFF)?0:ZFLAG) |
+        ((r&0x8000)?NFLAG:0);
+      break;
+    case LF_CMPL:
+      neg= C1L(b);
+      mask= NFLAG|ZFLAG|VFLAG|CFLAG;
+      flags=
+        ((~(((neg&a)|((neg^a)&(~r))))&0x80000000)?CFLAG:0) |
+        (((~(neg^a))&(r^neg)&0x80000000)?VFLAG:0) |
+        (r?0:ZFLAG) |
+        ((r&0x80000000)?NFLAG:0);
+      break;
+    case LF_ADDB:
+      mask= XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG;
+      flags=
+        ((r&0x100)?(CFLAG|XFLAG):0) |
+        (((~(a^b))&(r^a)&0x80)?VFLAG:0) |
+        ((r&0xFF)?0:ZFLAG) |
+        ((r&0x80)?NFLAG:0);
+      break;
+    case LF_ADDW:
+      mask= XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG;
+      flags=
+        ((r&0x10000)?(CFLAG|XFLAG):0) |
+        (((~(a^b))&(r^a)&0x8000)?VFLAG:0) |
+        ((r&0xFFFF)?0:ZFLAG) |
+        ((r&0x8000)?NFLAG:0);
+      break;
+    case LF_ADDL:
+      mask= XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG;
+      flags=
+        ((((a&b)|((a^b)&(~r)))&0x80000000)?(CFLAG|XFLAG):0) |
+        (((~(a^b))&(r^a)&0x80000000)?VFLAG:0) |
+        (r?0:ZFLAG) |
+        ((r&0x80000000)?NFLAG:0);
+      break;
+    case LF_SUBB:
+      neg= C1B(b);
+      mask= XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG;
+      flags=
+        (((~r)&0x100)?(CFLAG|XFLAG):0) |
+        (((~(neg^a))&(r^neg)&0x80)?VFLAG:0) |
+        ((r&0xFF)?0:ZFLAG) |
+        ((r&0x80)?NFLAG:0);
+      break;
+    case LF_SUBW:
+      neg= C1W(b);
+      mask= XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG;
+      flags=
+        (((~r)&0x10000)?(CFLAG|XFLAG):0) |
+        (((~(neg^a))&(r^neg)&0x8000)?VFLAG:0) |
+        ((r&0xFFFF)?0:ZFLAG) |
+        ((r&0x8000)?NFLAG:0);
+      break;
+    case LF_SUBL:
+      neg= C1L(b);
+      mask= XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG;
+      flags=
+        ((~(((neg&a)|((neg^a)&(~r))))&0x80000000)?(CFLAG|XFLAG):0) |
+        (((~(neg^a))&(r^neg)&0x80000000)?VFLAG:0) |
+        (r?0:ZFLAG) |
+        ((r&0x80000000)?NFLAG:0);
+      break;
+    case LF_NONE:
+    default: return;
+    }
+  _regs.CCR.v= (_regs.CCR.v&(mask^0xFFFF)) | flags;
+  _lf.op= LF_NONE;
+  
+} /* end sync_flags */
+
+
+static MD_Word *
+sreg (void)
+{
+  
+  if ( _lf.op != LF_NONE ) sync_flags ();
+  
+  return &_regs.CCR;
+  
+} /* end sreg */
+
+
+/* Per a les condicions més habituals (EQ/NE) no cal calcular tots els
+ * flags.
+ */
+static MD_Bool
+get_zflag (void)
+{
+  
+  static const MDu32 mask[3]= { 0xFF, 0xFFFF, 0xFFFFFFFF };
+  
+  
+  if ( _lf.op == LF_NONE ) return (_regs.CCR.v&ZFLAG)!=0;
+  
+  return (_lf.res&mask[(_lf.op-LF_LOGB)%3])==0;
+  
+} /* end get_zflag */
+
+
+/* Desa una operació per a calcular els seus flags més avant. Si
+ * l'operació pendent modifica X i la nova no, cal calcular-los abans.
+ */
+static void
+set_lazy_flags (
+        	lf_op_t const op,
+        	MDu32 const   src,
+        	MDu32 const   dst,
+        	MDu32 const   res
+        	)
+{
+  
+  if ( _lf.op >= LF_ADDB && op < LF_ADDB ) sync_flags ();
+  _lf.op= op;
+  _lf.src= src;
+  _lf.dst= dst;
+  _lf.res= res;
+  
+} /* end set_lazy_flags */
+
+/* Accés directe a memòria ***************************************************/
+/* Torna a calcular la regió que conté l'adreça indicada. En mode
+ * traça no es fa servir per a que tots els accessos passen per
+ * MD_mem_read.
+ */
+static void
+region_update (
+               region_t    *region,
+               const MDu32  addr
+               )
+{
+  
+  if ( _bc.trace ) region->words= NULL;
+  else region->words= MD_mem_get_code_region ( addr, &(region->start),
+        					&(region->size) );
+  if ( region->words == NULL ) region->size= 0;
+  
+} /* end region_update */
+
+
+static MD_Word
+fetch_slow (
+            const MDu32 addr
+            )
+{
+  
+  region_update ( &_fetch, addr );
+  if ( _fetch.size != 0 )
+    {
+#ifdef MD_CPU_PROFILE
+      ++_prof.reads;
+#endif
+      return _fetch.words[((addr&0xFFFFFF)-_fetch.start)>>1];
+    }
+  
+  return MD_mem_read ( addr );
+  
+} /* end fetch_slow */
+
+
+static MD_Word
+fetch (
+       const MDu32 addr
+       )
+{
+  
+  MDu32 off;
+  
+  
+  off= (addr&0xFFFFFF) - _fetch.start;
+  if ( off < _fetch.size )
+    {
+#ifdef MD_CPU_PROFILE
+      ++_prof.reads;
+#endif
+      return _fetch.words[off>>1];
+    }
+  
+  return fetch_slow ( addr );
+  
+} /* end fetch */
+
+
+/* Torna un punter per a llegir directament NBYTES a partir de
+ * l'adreça indicada, o NULL si cal gastar MD_mem_read.
+ */
+static const MD_Word *
+read_span (
+           const MDu32 addr,
+           const MDu32 nbytes
+           )
+{
+  
+  MDu32 off;
+  
+  
+  off= (addr&0xFFFFFF) - _data.start;
+  if ( off >= _data.size || nbytes > _data.size-off )
+    {
+      if ( _watch ) return NULL;
+      region_update ( &_data, addr );
+      off= (addr&0xFFFFFF) - _data.start;
+      if ( off >= _data.size || nbytes > _data.size-off ) return NULL;
+    }
+#ifdef MD_CPU_PROFILE
+  _prof.reads+= nbytes>>1;
+#endif
+  
+  return &(_data.words[off>>1]);
+  
+} /* end read_span */
+
+
+/* Torna un punter per a escriure directament NBYTES en la RAM, o NULL
+ * si cal gastar MD_mem_write.
+ */
+static MD_Word *
+write_span (
+            const MDu32 addr,
+            const MDu32 nbytes
+            )
+{
+  
+  MD_Word *ret;
+  
+  
+  ret= MD_mem_get_write_span ( addr, nbytes );
+#ifdef MD_CPU_PROFILE
+  if ( ret != NULL ) _prof.writes+= nbytes>>1;
+#endif
+  
+  return ret;
+  
+} /* end write_span */
+
+
 static MDu32
 calc_8bit_displacement (void)
 {
@@ -130,7 +731,7 @@ calc_8bit_displacement (void)
   MDu32 aux;
   
   
-  ew= MD_mem_read ( _regs.PC );
+  ew= fetch ( _regs.PC );
   _regs.PC+= 2;
   switch ( ew.b.v1>>3 ) /* D/A Reg.Num. W/L */
     {
@@ -179,29 +780,29 @@ calc_8bit_displacement (void)
 static MD_Reg32 pd16an (const MD_Reg32 reg)
 {
   MD_Reg32 addr;
-  addr.v= reg.v + (MDs16) MD_mem_read ( _regs.PC ).v;
+  addr.v= reg.v + (MDs16) fetch ( _regs.PC ).v;
   _regs.PC+= 2;
   return addr;
 }
 static MD_Reg32 pw (void)
 {
   MD_Reg32 addr;
-  addr.v= (MDs16) MD_mem_read ( _regs.PC ).v;
+  addr.v= (MDs16) fetch ( _regs.PC ).v;
   _regs.PC+= 2;
   return addr;
 }
 static MD_Reg32 pl (void)
 {
   MD_Reg32 addr;
-  addr.w.v1= MD_mem_read ( _regs.PC );
-  addr.w.v0= MD_mem_read ( _regs.PC+2 );
+  addr.w.v1= fetch ( _regs.PC );
+  addr.w.v0= fetch ( _regs.PC+2 );
   _regs.PC+= 4;
   return addr;
 }
 static MD_Reg32 pd16pc (void)
 {
   MD_Reg32 addr;
-  addr.v= _regs.PC + (MDs16) MD_mem_read ( _regs.PC ).v;
+  addr.v= _regs.PC + (MDs16) fetch ( _regs.PC ).v;
   _regs.PC+= 2;
   return addr;
 }
@@ -211,36 +812,54 @@ static MD_Reg32 pd16pc (void)
 static MDu8 inm_byte (void)
 {
   MDu8 byte;
-  byte= MD_mem_read ( _regs.PC ).b.v0;
+  byte= fetch ( _regs.PC ).b.v0;
   _regs.PC+= 2;
   return byte;
 }
 static MD_Reg32 inm_long (void)
 {
   MD_Reg32 long_;
-  long_.w.v1= MD_mem_read ( _regs.PC );
-  long_.w.v0= MD_mem_read ( _regs.PC+2 );
+  long_.w.v1= fetch ( _regs.PC );
+  long_.w.v0= fetch ( _regs.PC+2 );
   _regs.PC+= 4;
   return long_;
 }
 static MD_Word inm_word (void)
 {
   MD_Word word;
-  word= MD_mem_read ( _regs.PC );
+  word= fetch ( _regs.PC );
   _regs.PC+= 2;
   return word;
 }
 static MD_Reg32 read_long (const MDu32 addr)
 {
   MD_Reg32 long_;
-  long_.w.v1= MD_mem_read ( addr );
-  long_.w.v0= MD_mem_read ( addr+2 );
+  const MD_Word *p;
+  if ( (p= read_span ( addr, 4 )) != NULL )
+    {
+      long_.w.v1= p[0];
+      long_.w.v0= p[1];
+    }
+  else
+    {
+      long_.w.v1= MD_mem_read ( addr );
+      long_.w.v0= MD_mem_read ( addr+2 );
+    }
   return long_;
 }
 static void write_long (const MD_Reg32 long_,const MDu32 addr)
 {
-  MD_mem_write ( addr, long_.w.v1 );
-  MD_mem_write ( addr+2, long_.w.v0 );
+  MD_Word *p;
+  if ( (p= write_span ( addr, 4 )) != NULL )
+    {
+      p[0]= long_.w.v1;
+      p[1]= long_.w.v0;
+    }
+  else
+    {
+      MD_mem_write ( addr, long_.w.v1 );
+      MD_mem_write ( addr+2, long_.w.v0 );
+    }
 }
 
 
@@ -255,7 +874,7 @@ trap (
   
   
   /* Si estava en mode usuari. */
-  if ( !(_regs.CCR.v&SFLAG) )
+  if ( !(SREG.v&SFLAG) )
     {
       tmp= _regs.A[7];
       _regs.A[7]= _regs._SP;
@@ -264,9 +883,9 @@ trap (
   _regs.A[7].v-= 4;
   write_long ( (MD_Reg32) _regs.PC, _regs.A[7].v );
   _regs.A[7].v-= 2;
-  MD_mem_write ( _regs.A[7].v, _regs.CCR );
+  MD_mem_write ( _regs.A[7].v, SREG );
   _regs.PC= read_long ( vector ).v;
-  _regs.CCR.v|= SFLAG;
+  SREG.v|= SFLAG;
   
   return 34;
   
@@ -277,7 +896,7 @@ static int
 reset_int (void)
 {
   
-  _regs.CCR.v= 0x2700;
+  SREG.v= 0x2700;
   _regs.A[7]= read_long ( 0x0000 );
   _regs.PC= read_long ( 0x0004 ).v;
   
@@ -292,7 +911,7 @@ auto_vector_int (
         	 )
 {
   
-  if ( priority <= ((_regs.CCR.v&0x700)>>8) ) return 0;
+  if ( priority <= ((SREG.v&0x700)>>8) ) return 0;
   trap ( (priority + 24)*4 );
   
   return 44;
@@ -325,6 +944,7 @@ interrupts (void)
         ret= auto_vector_int ( i );
         if ( ret != 0 )
           {
+            MD_cpu_sync ();
             MD_vdp_clear_interrupt ( i );
             _ints^= mask;
           }
@@ -403,22 +1023,22 @@ move_from_sr (
   
   switch ( mode )
     {
-    case 0: _regs.D[reg].w.v0= _regs.CCR; return 6;
-    case 2: MD_mem_write ( _regs.A[reg].v, _regs.CCR ); return 12;
+    case 0: _regs.D[reg].w.v0= SREG; return 6;
+    case 2: MD_mem_write ( _regs.A[reg].v, SREG ); return 12;
     case 3:
-      MD_mem_write ( _regs.A[reg].v, _regs.CCR );
+      MD_mem_write ( _regs.A[reg].v, SREG );
       _regs.A[reg].v+= 2;
       return 12;
-    case 4: MD_mem_write ( _regs.A[reg].v-= 2, _regs.CCR ); return 14;
-    case 5: MD_mem_write ( pd16an ( _regs.A[reg] ).v, _regs.CCR ); return 16;
+    case 4: MD_mem_write ( _regs.A[reg].v-= 2, SREG ); return 14;
+    case 5: MD_mem_write ( pd16an ( _regs.A[reg] ).v, SREG ); return 16;
     case 6:
-      MD_mem_write ( _regs.A[reg].v + calc_8bit_displacement (), _regs.CCR );
+      MD_mem_write ( _regs.A[reg].v + calc_8bit_displacement (), SREG );
       return 18;
     case 7:
       switch ( reg )
         {
-        case 0: MD_mem_write ( pw ().v, _regs.CCR ); return 16;
-        case 1: MD_mem_write ( pl ().v, _regs.CCR ); return 20;
+        case 0: MD_mem_write ( pw ().v, SREG ); return 16;
+        case 1: MD_mem_write ( pl ().v, SREG ); return 20;
         default:
           _warning ( _udata,
         	     "MOVE from SR no accepta mode:reg 7:%d", reg );
@@ -488,7 +1108,7 @@ move_to_ccr (
       break;
     default: byte= ret= 0; /* CALLA*/ break;
     }
-  _regs.CCR.b.v0= byte&0x1F;
+  SREG.b.v0= byte&0x1F;
   
   return ret;
   
@@ -602,8 +1222,7 @@ moveb (
     }
   
   /* Flags. */
-  CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|= ((tmp==0x00)?ZFLAG:0) | ((tmp&0x80)?NFLAG:0);
+  set_lazy_flags ( LF_LOGB, 0, 0, tmp );
   
   return ret;
   
@@ -616,9 +1235,7 @@ movel_setflags (
         	)
 {
   
-  CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    ((reg.v==0x00000000)?ZFLAG:0) | ((reg.v&0x80000000)?NFLAG:0);
+  set_lazy_flags ( LF_LOGL, 0, 0, reg.v );
   
 } /* end movel_setflags */
 
@@ -728,9 +1345,85 @@ movel (
 } /* end movel */
 
 
+/* Versions directes de MOVEM quan tota la transferència cau en la
+ * ROM o la RAM. SIZE és 2 o 4. Tornen els cicles de la transferència
+ * o -1 si cal fer-la registre a registre.
+ */
+static int movem_read_fast (const MDu32 addr,const MD_Word mask,
+        		    const MDu32 size)
+{
+  const MD_Word *p; int i,ret;
+  if ( (p= read_span ( addr, MOVEM_NREGS ( mask )*size )) == NULL )
+    return -1;
+  ret= 0;
+  for ( i= 0; i < 16; ++i )
+    if ( mask.v&(1<<i) )
+      {
+        if ( size == 4 )
+          {
+            _movem_regs[i]->w.v1= p[0];
+            _movem_regs[i]->w.v0= p[1];
+            p+= 2; ret+= 8;
+          }
+        else { _movem_regs[i]->v= (MDs16) p[0].v; ++p; ret+= 4; }
+      }
+  return ret;
+}
+
+
+static int movem_write_fast (const MDu32 addr,const MD_Word mask,
+        		     const MDu32 size)
+{
+  MD_Word *p; int i,ret;
+  if ( (p= write_span ( addr, MOVEM_NREGS ( mask )*size )) == NULL )
+    return -1;
+  ret= 0;
+  for ( i= 0; i < 16; ++i )
+    if ( mask.v&(1<<i) )
+      {
+        if ( size == 4 )
+          {
+            p[0]= _movem_regs[i]->w.v1;
+            p[1]= _movem_regs[i]->w.v0;
+            p+= 2; ret+= 10;
+          }
+        else { p[0]= _movem_regs[i]->w.v0; ++p; ret+= 5; }
+      }
+  return ret;
+}
+
+
+/* Predecrement: la màscara va d'A7 a D0 i s'escriu cap arrere des de
+ * END.
+ */
+static int movem_write_pd_fast (const MDu32 end,const MD_Word mask,
+        			const MDu32 size)
+{
+  MD_Word *p; MDu32 nbytes; int i,ret;
+  nbytes= MOVEM_NREGS ( mask )*size;
+  if ( (p= write_span ( end-nbytes, nbytes )) == NULL ) return -1;
+  p+= nbytes>>1;
+  ret= 0;
+  for ( i= 0; i < 16; ++i )
+    if ( mask.v&(1<<i) )
+      {
+        if ( size == 4 )
+          {
+            p-= 2;
+            p[0]= _movem_regs[15-i]->w.v1;
+            p[1]= _movem_regs[15-i]->w.v0;
+            ret+= 10;
+          }
+        else { --p; p[0]= _movem_regs[15-i]->w.v0; ret+= 5; }
+      }
+  return ret;
+}
+
+
 static int moveml_addr_l (MDu32 addr,const MD_Word mask)
 {
   int ret;
+  if ( (ret= movem_read_fast ( addr, mask, 4 )) != -1 ) return ret;
   ret= 0;
   if ( mask.v&0x0001 ) {_regs.D[0]=read_long(addr); addr+=4; ret+=8;}
   if ( mask.v&0x0002 ) {_regs.D[1]=read_long(addr); addr+=4; ret+=8;}
@@ -756,6 +1449,11 @@ static int moveml_pani_l (MD_Reg32 * const reg,const MD_Word mask)
 {
   MDu32 addr; int ret;
   addr= reg->v;
+  if ( (ret= movem_read_fast ( addr, mask, 4 )) != -1 )
+    {
+      reg->v= addr + MOVEM_NREGS ( mask )*4;
+      return ret;
+    }
   ret= 0;
   if ( mask.v&0x0001 ) {_regs.D[0]=read_long(addr); addr+=4; ret+=8;}
   if ( mask.v&0x0002 ) {_regs.D[1]=read_long(addr); addr+=4; ret+=8;}
@@ -827,6 +1525,7 @@ moveml_mem_reg (
 static int moveml_l_addr (MDu32 addr,const MD_Word mask)
 {
   int ret;
+  if ( (ret= movem_write_fast ( addr, mask, 4 )) != -1 ) return ret;
   ret= 0;
   if ( mask.v&0x0001 ) {write_long(_regs.D[0],addr); addr+=4; ret+=10;}
   if ( mask.v&0x0002 ) {write_long(_regs.D[1],addr); addr+=4; ret+=10;}
@@ -851,6 +1550,11 @@ static int moveml_l_addr (MDu32 addr,const MD_Word mask)
 static int moveml_l_pand (MD_Reg32 * const reg,const MD_Word mask)
 {
   MDu32 addr; int ret;
+  if ( (ret= movem_write_pd_fast ( reg->v, mask, 4 )) != -1 )
+    {
+      reg->v-= MOVEM_NREGS ( mask )*4;
+      return ret;
+    }
   addr= reg->v-4;
   ret= 0;
   if ( mask.v&0x0001 ) {write_long(_regs.A[7],addr); addr-=4; ret+=10;}
@@ -917,6 +1621,7 @@ moveml_reg_mem (
 static int movemw_addr_l (MDu32 addr,const MD_Word mask)
 {
   int ret;
+  if ( (ret= movem_read_fast ( addr, mask, 2 )) != -1 ) return ret;
   ret= 0;
   if (mask.v&0x0001) {_regs.D[0].v=(MDs16)MD_mem_read(addr).v; addr+=2; ret+=4;}
   if (mask.v&0x0002) {_regs.D[1].v=(MDs16)MD_mem_read(addr).v; addr+=2; ret+=4;}
@@ -942,6 +1647,11 @@ static int movemw_pani_l (MD_Reg32 * const reg,const MD_Word mask)
 {
   MDu32 addr; int ret;
   addr= reg->v;
+  if ( (ret= movem_read_fast ( addr, mask, 2 )) != -1 )
+    {
+      reg->v= addr + MOVEM_NREGS ( mask )*2;
+      return ret;
+    }
   ret= 0;
   if (mask.v&0x0001) {_regs.D[0].v=(MDs16)MD_mem_read(addr).v; addr+=2; ret+=4;}
   if (mask.v&0x0002) {_regs.D[1].v=(MDs16)MD_mem_read(addr).v; addr+=2; ret+=4;}
@@ -1013,6 +1723,7 @@ movemw_mem_reg (
 static int movemw_l_addr (MDu32 addr,MD_Word const mask)
 {
   int ret;
+  if ( (ret= movem_write_fast ( addr, mask, 2 )) != -1 ) return ret;
   ret= 0;
   if ( mask.v&0x0001 ) {MD_mem_write(addr,_regs.D[0].w.v0); addr+=2; ret+=5;}
   if ( mask.v&0x0002 ) {MD_mem_write(addr,_regs.D[1].w.v0); addr+=2; ret+=5;}
@@ -1037,6 +1748,11 @@ static int movemw_l_addr (MDu32 addr,MD_Word const mask)
 static int movemw_l_pand (MD_Reg32 * const reg,const MD_Word mask)
 {
   MDu32 addr; int ret;
+  if ( (ret= movem_write_pd_fast ( reg->v, mask, 2 )) != -1 )
+    {
+      reg->v-= MOVEM_NREGS ( mask )*2;
+      return ret;
+    }
   addr= reg->v-2;
   ret= 0;
   if ( mask.v&0x0001 ) {MD_mem_write(addr,_regs.A[7].w.v0); addr-=2; ret+=5;}
@@ -1280,8 +1996,7 @@ movew (
   /* Flags. */
   if ( !movea )
     {
-      CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|= ((tmp.v==0x0000)?ZFLAG:0) | ((tmp.v&0x8000)?NFLAG:0);
+      set_lazy_flags ( LF_LOGW, 0, 0, tmp.v );
     }
   
   return ret;
@@ -1372,12 +2087,7 @@ addb (
   
   
   aux= a + b;
-  CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    ((aux&0x100)?(CFLAG|XFLAG):0) |
-    (((~(a^b))&(aux^a)&0x80)?VFLAG:0) |
-    ((aux&0xFF)?0:ZFLAG) |
-    ((aux&0x80)?NFLAG:0);
+  set_lazy_flags ( LF_ADDB, b, a, aux );
   
   return (MDu8) aux; /* No cal fer &0xFF */
   
@@ -1394,9 +2104,9 @@ addb_x (
   MDu32 aux;
   
   
-  aux= a + b + ((_regs.CCR.v&XFLAG)?1:0);
+  aux= a + b + ((SREG.v&XFLAG)?1:0);
   CLEAR_FLAGS ( XFLAG|NFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
+  SREG.v|=
     ((aux&0x100)?(CFLAG|XFLAG):0) |
     (((~(a^b))&(aux^a)&0x80)?VFLAG:0) |
     ((aux&0x80)?NFLAG:0);
@@ -1418,12 +2128,7 @@ addl (
   
   
   aux.v= a.v + b.v;
-  CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    ((((a.v&b.v)|((a.v^b.v)&(~aux.v)))&0x80000000)?(CFLAG|XFLAG):0) |
-    (((~(a.v^b.v))&(aux.v^a.v)&0x80000000)?VFLAG:0) |
-    (aux.v?0:ZFLAG) |
-    ((aux.v&0x80000000)?NFLAG:0);
+  set_lazy_flags ( LF_ADDL, b.v, a.v, aux.v );
   
   return aux;
   
@@ -1440,9 +2145,9 @@ addl_x (
   MD_Reg32 aux;
   
   
-  aux.v= a.v + b.v + ((_regs.CCR.v&XFLAG)?1:0);
+  aux.v= a.v + b.v + ((SREG.v&XFLAG)?1:0);
   CLEAR_FLAGS ( XFLAG|NFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
+  SREG.v|=
     ((((a.v&b.v)|((a.v^b.v)&(~aux.v)))&0x80000000)?(CFLAG|XFLAG):0) |
     (((~(a.v^b.v))&(aux.v^a.v)&0x80000000)?VFLAG:0) |
     ((aux.v&0x80000000)?NFLAG:0);
@@ -1464,12 +2169,7 @@ addw (
   
   
   aux.v= a.v + b.v;
-  CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    ((aux.v&0x10000)?(CFLAG|XFLAG):0) |
-    (((~(a.v^b.v))&(aux.v^a.v)&0x8000)?VFLAG:0) |
-    (aux.w.v0.v?0:ZFLAG) |
-    ((aux.v&0x8000)?NFLAG:0);
+  set_lazy_flags ( LF_ADDW, b.v, a.v, aux.v );
   
   return aux.w.v0;
   
@@ -1486,9 +2186,9 @@ addw_x (
   MD_Reg32 aux;
   
   
-  aux.v= a.v + b.v + ((_regs.CCR.v&XFLAG)?1:0);
+  aux.v= a.v + b.v + ((SREG.v&XFLAG)?1:0);
   CLEAR_FLAGS ( XFLAG|NFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
+  SREG.v|=
     ((aux.v&0x10000)?(CFLAG|XFLAG):0) |
     (((~(a.v^b.v))&(aux.v^a.v)&0x8000)?VFLAG:0) |
     ((aux.v&0x8000)?NFLAG:0);
@@ -1523,12 +2223,7 @@ subb (
   
   neg= C1B(src);
   aux= (dst + neg) + 1;
-  CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    (((~aux)&0x100)?(CFLAG|XFLAG):0) |
-    (((~(neg^dst))&(aux^neg)&0x80)?VFLAG:0) |
-    ((aux&0xFF)?0:ZFLAG) |
-    ((aux&0x80)?NFLAG:0);
+  set_lazy_flags ( LF_SUBB, src, dst, aux );
   
   return (MDu8) aux; /* No cal fer &0xFF */
   
@@ -1547,9 +2242,9 @@ subb_x (
   
   
   neg= C1B(src);
-  aux= (dst + neg) + ((_regs.CCR.v&XFLAG)?0:1);
+  aux= (dst + neg) + ((SREG.v&XFLAG)?0:1);
   CLEAR_FLAGS ( XFLAG|NFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
+  SREG.v|=
     (((~aux)&0x100)?(CFLAG|XFLAG):0) |
     (((~(neg^dst))&(aux^neg)&0x80)?VFLAG:0) |
     ((aux&0x80)?NFLAG:0);
@@ -1574,12 +2269,7 @@ subl (
   
   neg= C1L(src.v);
   aux.v= (dst.v + neg) + 1;
-  CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    ((~(((neg&dst.v)|((neg^dst.v)&(~aux.v))))&0x80000000)?(CFLAG|XFLAG):0) |
-    (((~(neg^dst.v))&(aux.v^neg)&0x80000000)?VFLAG:0) |
-    (aux.v?0:ZFLAG) |
-    ((aux.v&0x80000000)?NFLAG:0);
+  set_lazy_flags ( LF_SUBL, src.v, dst.v, aux.v );
   
   return aux;
   
@@ -1598,9 +2288,9 @@ subl_x (
   
   
   neg= C1L(src.v);
-  aux.v= (dst.v + neg) + ((_regs.CCR.v&XFLAG)?0:1);
+  aux.v= (dst.v + neg) + ((SREG.v&XFLAG)?0:1);
   CLEAR_FLAGS ( XFLAG|NFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
+  SREG.v|=
     ((~(((neg&dst.v)|((neg^dst.v)&(~aux.v))))&0x80000000)?(CFLAG|XFLAG):0) |
     (((~(neg^dst.v))&(aux.v^neg)&0x80000000)?VFLAG:0) |
     ((aux.v&0x80000000)?NFLAG:0);
@@ -1625,12 +2315,7 @@ subw (
   
   neg.v= C1W(src.v);
   aux.v= (dst.v + neg.v) + 1;
-  CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    (((~aux.v)&0x10000)?(CFLAG|XFLAG):0) |
-    (((~(neg.v^dst.v))&(aux.v^neg.v)&0x8000)?VFLAG:0) |
-    (aux.w.v0.v?0:ZFLAG) |
-    ((aux.v&0x8000)?NFLAG:0);
+  set_lazy_flags ( LF_SUBW, src.v, dst.v, aux.v );
   
   return aux.w.v0;
   
@@ -1649,9 +2334,9 @@ subw_x (
   
   
   neg.v= C1W(src.v);
-  aux.v= (dst.v + neg.v) + ((_regs.CCR.v&XFLAG)?0:1);
+  aux.v= (dst.v + neg.v) + ((SREG.v&XFLAG)?0:1);
   CLEAR_FLAGS ( XFLAG|NFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
+  SREG.v|=
     (((~aux.v)&0x10000)?(CFLAG|XFLAG):0) |
     (((~(neg.v^dst.v))&(aux.v^neg.v)&0x8000)?VFLAG:0) |
     ((aux.v&0x8000)?NFLAG:0);
@@ -1673,7 +2358,7 @@ extl (
   
   _regs.D[reg].v= aux= (MDs16) _regs.D[reg].w.v0.v;
   CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|= ((aux&0x80000000)?NFLAG:0) | ((aux==0)?ZFLAG:0);
+  SREG.v|= ((aux&0x80000000)?NFLAG:0) | ((aux==0)?ZFLAG:0);
   
   return 4;
   
@@ -1691,7 +2376,7 @@ extw (
   
   _regs.D[reg].w.v0.v= aux= (MDs8) _regs.D[reg].b.v0;
   CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|= ((aux&0x8000)?NFLAG:0) | ((aux==0)?ZFLAG:0);
+  SREG.v|= ((aux&0x8000)?NFLAG:0) | ((aux==0)?ZFLAG:0);
   
   return 4;
   
@@ -1709,7 +2394,7 @@ clrb (
   
   
   CLEAR_FLAGS ( NFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|= ZFLAG;
+  SREG.v|= ZFLAG;
   switch ( mode )
     {
     case 0: _regs.D[reg].b.v0= 0; return 4;
@@ -1753,7 +2438,7 @@ clrl (
   MD_Reg32 const zero= { 0 };
   
   CLEAR_FLAGS ( NFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|= ZFLAG;
+  SREG.v|= ZFLAG;
   switch ( mode )
     {
     case 0: _regs.D[reg]= zero; return 6;
@@ -1794,7 +2479,7 @@ clrw (
   
   
   CLEAR_FLAGS ( NFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|= ZFLAG;
+  SREG.v|= ZFLAG;
   switch ( mode )
     {
     case 0: _regs.D[reg].w.v0= zero; return 4;
@@ -1836,12 +2521,7 @@ cmp (
   
   neg= C1L(src);
   aux= (dst + neg) + 1;
-  CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    ((~(((neg&dst)|((neg^dst)&(~aux))))&0x80000000)?(CFLAG):0) |
-    (((~(neg^dst))&(aux^neg)&0x80000000)?VFLAG:0) |
-    (aux?0:ZFLAG) |
-    ((aux&0x80000000)?NFLAG:0);
+  set_lazy_flags ( LF_CMPL, src, dst, aux );
 
 } /* end cmp */
 
@@ -1859,12 +2539,7 @@ cmp_byte (
   
   neg= C1B(src);
   aux= (dst + neg) + 1;
-  CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    (((~aux)&0x100)?(CFLAG):0) |
-    (((~(neg^dst))&(aux^neg)&0x80)?VFLAG:0) |
-    ((aux&0xFF)?0:ZFLAG) |
-    ((aux&0x80)?NFLAG:0);
+  set_lazy_flags ( LF_CMPB, src, dst, aux );
 
 } /* end cmp_byte */
 
@@ -1882,12 +2557,7 @@ cmp_word (
   
   neg.v= C1W(src.v);
   aux.v= (dst.v + neg.v) + 1;
-  CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    (((~aux.v)&0x10000)?(CFLAG):0) |
-    (((~(neg.v^dst.v))&(aux.v^neg.v)&0x8000)?VFLAG:0) |
-    (aux.w.v0.v?0:ZFLAG) |
-    ((aux.v&0x8000)?NFLAG:0);
+  set_lazy_flags ( LF_CMPW, src.v, dst.v, aux.v );
   
 } /* end cmp_word */
 
@@ -2451,13 +3121,13 @@ divs (
   quo= ((MDs32) _regs.D[reg].v)/((MDs16) word.v);
   if ( quo >= -32768 && quo <= 32767 )
     {
-      if ( quo < 0 ) _regs.CCR.v|= NFLAG;
-      if ( quo == 0 ) _regs.CCR.v|= ZFLAG;
+      if ( quo < 0 ) SREG.v|= NFLAG;
+      if ( quo == 0 ) SREG.v|= ZFLAG;
       rem= ((MDs32) _regs.D[reg].v)%((MDs16) word.v);
       _regs.D[reg].w.v0.v= (MDu16) ((MDs16) quo);
       _regs.D[reg].w.v1.v= (MDu16) ((MDs16) rem);
     }
-  else _regs.CCR.v|= VFLAG;
+  else SREG.v|= VFLAG;
   
   return 158+ret;
   
@@ -2521,13 +3191,13 @@ divu (
   quo= _regs.D[reg].v/word.v;
   if ( quo <= 65535 )
     {
-      if ( quo&0x8000 /*¿¿??*/) _regs.CCR.v|= NFLAG;
-      if ( quo == 0 ) _regs.CCR.v|= ZFLAG;
+      if ( quo&0x8000 /*¿¿??*/) SREG.v|= NFLAG;
+      if ( quo == 0 ) SREG.v|= ZFLAG;
       rem= _regs.D[reg].v%word.v;
       _regs.D[reg].w.v0.v= quo;
       _regs.D[reg].w.v1.v= rem;
     }
-  else _regs.CCR.v|= VFLAG;
+  else SREG.v|= VFLAG;
   
   return 140+ret;
   
@@ -2590,8 +3260,8 @@ muls (
   _regs.D[reg].v= res=
     ((MDs32) ((MDs16) _regs.D[reg].w.v0.v)) *
     ((MDs32) ((MDs16) word.v));
-  if ( res < 0 ) _regs.CCR.v|= NFLAG;
-  else if ( res == 0 ) _regs.CCR.v|= ZFLAG;
+  if ( res < 0 ) SREG.v|= NFLAG;
+  else if ( res == 0 ) SREG.v|= ZFLAG;
   
   return 70+ret;
   
@@ -2651,8 +3321,8 @@ mulu (
   
   CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
   _regs.D[reg].v= res= ((MDu32) _regs.D[reg].w.v0.v) * ((MDu32) word.v);
-  if ( res&0x80000000 /*¿¿??*/ ) _regs.CCR.v|= NFLAG;
-  if ( res == 0 ) _regs.CCR.v|= ZFLAG;
+  if ( res&0x80000000 /*¿¿??*/ ) SREG.v|= NFLAG;
+  if ( res == 0 ) SREG.v|= ZFLAG;
   
   return 70+ret;
   
@@ -3763,10 +4433,7 @@ logb_flags (
             )
 {
   
-  CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    (val?0:ZFLAG) |
-    ((val&0x80)?NFLAG:0);
+  set_lazy_flags ( LF_LOGB, 0, 0, val );
   
 } /* end logb_flags */
 
@@ -3777,10 +4444,7 @@ logl_flags (
             )
 {
   
-  CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    (val.v?0:ZFLAG) |
-    ((val.v&0x80000000)?NFLAG:0);
+  set_lazy_flags ( LF_LOGL, 0, 0, val.v );
   
 } /* end logl_flags */
 
@@ -3791,10 +4455,7 @@ logw_flags (
             )
 {
   
-  CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    (val.v?0:ZFLAG) |
-    ((val.v&0x8000)?NFLAG:0);
+  set_lazy_flags ( LF_LOGW, 0, 0, val.v );
   
 } /* end logw_flags */
 
@@ -4274,14 +4935,14 @@ aslb (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (next?NFLAG:0) |
         (ret?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(XFLAG|CFLAG):0) |
         (next?NFLAG:0) |
         (flag?VFLAG:0) |
@@ -4320,14 +4981,14 @@ asll (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(XFLAG|CFLAG):0) |
         (next?NFLAG:0) |
         (flag?VFLAG:0) |
@@ -4366,14 +5027,14 @@ aslw (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(XFLAG|CFLAG):0) |
         (next?NFLAG:0) |
         (flag?VFLAG:0) |
@@ -4409,14 +5070,14 @@ asrb (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (msb?NFLAG:0) |
         (ret?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(XFLAG|CFLAG):0) |
         (msb?NFLAG:0) |
         (ret?0:ZFLAG);
@@ -4452,14 +5113,14 @@ asrl (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (msb?NFLAG:0) |
         (ret.v?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(XFLAG|CFLAG):0) |
         (msb?NFLAG:0) |
         (ret.v?0:ZFLAG);
@@ -4495,14 +5156,14 @@ asrw (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (msb?NFLAG:0) |
         (ret.v?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(XFLAG|CFLAG):0) |
         (msb?NFLAG:0) |
         (ret.v?0:ZFLAG);
@@ -4536,14 +5197,14 @@ lslb (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (next?NFLAG:0) |
         (ret?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(XFLAG|CFLAG):0) |
         (next?NFLAG:0) |
         (ret?0:ZFLAG);
@@ -4578,14 +5239,14 @@ lsll (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(XFLAG|CFLAG):0) |
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG);
@@ -4620,14 +5281,14 @@ lslw (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(XFLAG|CFLAG):0) |
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG);
@@ -4661,14 +5322,14 @@ lsrb (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         ((ret&0x80)?NFLAG:0) |
         (ret?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(XFLAG|CFLAG):0) |
         ((ret&0x80)?NFLAG:0) |
         (ret?0:ZFLAG);
@@ -4703,14 +5364,14 @@ lsrl (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         ((ret.v&0x80000000)?NFLAG:0) |
         (ret.v?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(XFLAG|CFLAG):0) |
         ((ret.v&0x80000000)?NFLAG:0) |
         (ret.v?0:ZFLAG);
@@ -4745,14 +5406,14 @@ lsrw (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         ((ret.v&0x8000)?NFLAG:0) |
         (ret.v?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(XFLAG|CFLAG):0) |
         ((ret.v&0x8000)?NFLAG:0) |
         (ret.v?0:ZFLAG);
@@ -4785,14 +5446,14 @@ rolb (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (next?NFLAG:0) |
         (ret?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(CFLAG):0) |
         (next?NFLAG:0) |
         (ret?0:ZFLAG);
@@ -4826,14 +5487,14 @@ roll (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(CFLAG):0) |
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG);
@@ -4867,14 +5528,14 @@ rolw (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(CFLAG):0) |
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG);
@@ -4907,14 +5568,14 @@ rorb (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         ((ret&0x80)?NFLAG:0) |
         (ret?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(NFLAG|CFLAG):0) |
         (ret?0:ZFLAG);
     }
@@ -4947,14 +5608,14 @@ rorl (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         ((ret.v&0x80000000)?NFLAG:0) |
         (ret.v?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(NFLAG|CFLAG):0) |
         (ret.v?0:ZFLAG);
     }
@@ -4987,14 +5648,14 @@ rorw (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         ((ret.v&0x8000)?NFLAG:0) |
         (ret.v?0:ZFLAG);
     }
   else
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (prev?(NFLAG|CFLAG):0) |
         (ret.v?0:ZFLAG);
     }
@@ -5017,7 +5678,7 @@ roxlb (
   
   ret= val;
   next= ret&0x80;
-  xflag= _regs.CCR.v&XFLAG;
+  xflag= SREG.v&XFLAG;
   for ( i= 0; i < count; ++i )
     {
       ret= (ret<<1) | (xflag?0x1:0x0);
@@ -5027,7 +5688,7 @@ roxlb (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (next?NFLAG:0) |
         (ret?0:ZFLAG) |
         (xflag?CFLAG:0);
@@ -5035,7 +5696,7 @@ roxlb (
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (xflag?(XFLAG|CFLAG):0) |
         (next?NFLAG:0) |
         (ret?0:ZFLAG);
@@ -5060,7 +5721,7 @@ roxll (
   
   ret= val;
   next= ret.v&0x80000000;
-  xflag= _regs.CCR.v&XFLAG;
+  xflag= SREG.v&XFLAG;
   for ( i= 0; i < count; ++i )
     {
       ret.v= (ret.v<<1) | (xflag?0x1:0x0);
@@ -5070,7 +5731,7 @@ roxll (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG) |
         (xflag?CFLAG:0);
@@ -5078,7 +5739,7 @@ roxll (
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (xflag?(XFLAG|CFLAG):0) |
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG);
@@ -5103,7 +5764,7 @@ roxlw (
   
   ret= val;
   next= ret.v&0x8000;
-  xflag= _regs.CCR.v&XFLAG;
+  xflag= SREG.v&XFLAG;
   for ( i= 0; i < count; ++i )
     {
       ret.v= (ret.v<<1) | (xflag?0x1:0x0);
@@ -5113,7 +5774,7 @@ roxlw (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG) |
         (xflag?CFLAG:0);
@@ -5121,7 +5782,7 @@ roxlw (
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (xflag?(XFLAG|CFLAG):0) |
         (next?NFLAG:0) |
         (ret.v?0:ZFLAG);
@@ -5145,7 +5806,7 @@ roxrb (
   
   ret= val;
   next= ret&0x01;
-  xflag= _regs.CCR.v&XFLAG;
+  xflag= SREG.v&XFLAG;
   for ( i= 0; i < count; ++i )
     {
       ret= (ret>>1) | (xflag?0x80:0x00);
@@ -5155,7 +5816,7 @@ roxrb (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         ((ret&0x80)?NFLAG:0) |
         (ret?0:ZFLAG) |
         (xflag?CFLAG:0);
@@ -5163,7 +5824,7 @@ roxrb (
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (xflag?(XFLAG|CFLAG):0) |
         ((ret&0x80)?NFLAG:0) |
         (ret?0:ZFLAG);
@@ -5188,7 +5849,7 @@ roxrl (
   
   ret= val;
   next= ret.v&0x00000001;
-  xflag= _regs.CCR.v&XFLAG;
+  xflag= SREG.v&XFLAG;
   for ( i= 0; i < count; ++i )
     {
       ret.v= (ret.v>>1) | (xflag?0x80000000:0x00000000);
@@ -5198,7 +5859,7 @@ roxrl (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         ((ret.v&0x80000000)?NFLAG:0) |
         (ret.v?0:ZFLAG) |
         (xflag?CFLAG:0);
@@ -5206,7 +5867,7 @@ roxrl (
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (xflag?(XFLAG|CFLAG):0) |
         ((ret.v&0x80000000)?NFLAG:0) |
         (ret.v?0:ZFLAG);
@@ -5231,7 +5892,7 @@ roxrw (
   
   ret= val;
   next= ret.v&0x0001;
-  xflag= _regs.CCR.v&XFLAG;
+  xflag= SREG.v&XFLAG;
   for ( i= 0; i < count; ++i )
     {
       ret.v= (ret.v>>1) | (xflag?0x8000:0x0000);
@@ -5241,7 +5902,7 @@ roxrw (
   if ( count == 0 )
     {
       CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         ((ret.v&0x8000)?NFLAG:0) |
         (ret.v?0:ZFLAG) |
         (xflag?CFLAG:0);
@@ -5249,7 +5910,7 @@ roxrw (
   else
     {
       CLEAR_FLAGS ( XFLAG|NFLAG|ZFLAG|VFLAG|CFLAG );
-      _regs.CCR.v|=
+      SREG.v|=
         (xflag?(XFLAG|CFLAG):0) |
         ((ret.v&0x8000)?NFLAG:0) |
         (ret.v?0:ZFLAG);
@@ -5423,7 +6084,7 @@ swap (
   _regs.D[reg].w.v0= _regs.D[reg].w.v1;
   _regs.D[reg].w.v1= tmp;
   CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
+  SREG.v|=
     ((_regs.D[reg].v&0x80000000)?NFLAG:0) |
     (_regs.D[reg].v?0:ZFLAG);
   
@@ -5446,7 +6107,7 @@ bchg_mem (
   mask= 0x1<<bit;
   byte= MD_mem_read8 ( addr );
   if ( byte&mask ) CLEAR_FLAGS ( ZFLAG );
-  else _regs.CCR.v|= ZFLAG;
+  else SREG.v|= ZFLAG;
   MD_mem_write8 ( addr, byte^mask );
   
   return 8;
@@ -5466,7 +6127,7 @@ bchg_reg (
   
   mask= 0x1<<bit;
   if ( _regs.D[reg].v&mask ) CLEAR_FLAGS ( ZFLAG );
-  else                       _regs.CCR.v|= ZFLAG;
+  else                       SREG.v|= ZFLAG;
   _regs.D[reg].v^= mask;
   
   return 12;
@@ -5487,7 +6148,7 @@ bclr_mem (
   mask= 0x1<<bit;
   byte= MD_mem_read8 ( addr );
   if ( byte&mask ) CLEAR_FLAGS ( ZFLAG );
-  else _regs.CCR.v|= ZFLAG;
+  else SREG.v|= ZFLAG;
   MD_mem_write8 ( addr, byte&(~mask) );
   
   return 8; /* ¿¿??? No entenc timing.txt */
@@ -5507,7 +6168,7 @@ bclr_reg (
   
   mask= 0x1<<bit;
   if ( _regs.D[reg].v&mask ) CLEAR_FLAGS ( ZFLAG );
-  else                       _regs.CCR.v|= ZFLAG;
+  else                       SREG.v|= ZFLAG;
   _regs.D[reg].v&= ~mask;
   
   return 12; /* ¿¿¿??? No entenc timing.txt */
@@ -5637,7 +6298,7 @@ bset_mem (
   mask= 0x1<<bit;
   byte= MD_mem_read8 ( addr );
   if ( byte&mask ) CLEAR_FLAGS ( ZFLAG );
-  else _regs.CCR.v|= ZFLAG;
+  else SREG.v|= ZFLAG;
   MD_mem_write8 ( addr, byte|mask );
   
   return 8;
@@ -5657,7 +6318,7 @@ bset_reg (
   
   mask= 0x1<<bit;
   if ( _regs.D[reg].v&mask ) CLEAR_FLAGS ( ZFLAG );
-  else                       _regs.CCR.v|= ZFLAG;
+  else                       SREG.v|= ZFLAG;
   _regs.D[reg].v|= mask;
   
   return 12;
@@ -5683,7 +6344,7 @@ btst_reg (
     case 0:
       mask= 0x1<<(_regs.D[reg].v&0x1F);
       if ( _regs.D[eareg].v&mask ) CLEAR_FLAGS ( ZFLAG );
-      else                         _regs.CCR.v|= ZFLAG;
+      else                         SREG.v|= ZFLAG;
       return 10; /* ¿¿?? No entenc timing.txt */
     case 2: addr= _regs.A[eareg].v; ret= 4; break;
     case 3:
@@ -5713,7 +6374,7 @@ btst_reg (
           byte= inm_byte ();
           mask= 0x1<<(_regs.D[reg].v&0x7);
           if ( byte&mask ) CLEAR_FLAGS ( ZFLAG );
-          else             _regs.CCR.v|= ZFLAG;
+          else             SREG.v|= ZFLAG;
           return 4 + 6;
           break;
         default:
@@ -5729,7 +6390,7 @@ btst_reg (
   
   mask= 0x1<<(_regs.D[reg].v&0x7);
   if ( MD_mem_read8 ( addr )&mask ) CLEAR_FLAGS ( ZFLAG );
-  else                              _regs.CCR.v|= ZFLAG;
+  else                              SREG.v|= ZFLAG;
   
   return ret + 6; /* ¿¿?? No entenc timing.txt */
   
@@ -5754,7 +6415,7 @@ btst_inm (
     case 0:
       mask= 0x1<<(byte&0x1F);
       if ( _regs.D[eareg].v&mask ) CLEAR_FLAGS ( ZFLAG );
-      else                         _regs.CCR.v|= ZFLAG;
+      else                         SREG.v|= ZFLAG;
       return 10; /* ¿¿?? No entenc timing.txt */
     case 2: addr= _regs.A[eareg].v; ret= 4; break;
     case 3:
@@ -5793,7 +6454,7 @@ btst_inm (
   
   mask= 0x1<<(byte&0x7);
   if ( MD_mem_read8 ( addr )&mask ) CLEAR_FLAGS ( ZFLAG );
-  else                              _regs.CCR.v|= ZFLAG;
+  else                              SREG.v|= ZFLAG;
   
   return ret + 6; /* ¿¿?? No entenc timing.txt */
   
@@ -5813,19 +6474,19 @@ abcd_op (
   MD_Bool cflag, hflag;
   
   
-  aux= src + dst + ((_regs.CCR.v&XFLAG)?1:0);
+  aux= src + dst + ((SREG.v&XFLAG)?1:0);
   cflag= ((aux&0x100)!=0);
   hflag= ((((src^dst)^aux)&0x10)!=0);
   ret= (MDu8) aux;
   CLEAR_FLAGS ( XFLAG|CFLAG );
   if ( hflag || (ret&0xF) > 9 )
     {
-      if ( cflag || ret > 0x99 ) { ret+= 0x66; _regs.CCR.v|= (CFLAG|XFLAG); }
+      if ( cflag || ret > 0x99 ) { ret+= 0x66; SREG.v|= (CFLAG|XFLAG); }
       else                         ret+= 0x06;
     }
   else
     {
-      if ( cflag || ret > 0x99 ) { ret+= 0x60; _regs.CCR.v|= (CFLAG|XFLAG); }
+      if ( cflag || ret > 0x99 ) { ret+= 0x60; SREG.v|= (CFLAG|XFLAG); }
     }
   if ( ret ) CLEAR_FLAGS ( ZFLAG );
   
@@ -5847,19 +6508,19 @@ sbcd_op (
   
   
   neg= C1B(src);
-  aux= (dst + neg) + ((_regs.CCR.v&XFLAG)?0:1);
+  aux= (dst + neg) + ((SREG.v&XFLAG)?0:1);
   cflag= ((aux&0x100)==0);
   hflag= ((((neg^dst)^aux)&0x10)==0);
   ret= (MDu8) aux;
   CLEAR_FLAGS ( XFLAG|CFLAG );
   if ( hflag )
     {
-      if ( cflag ) { ret+= 0x9A; _regs.CCR.v|= (CFLAG|XFLAG); }
+      if ( cflag ) { ret+= 0x9A; SREG.v|= (CFLAG|XFLAG); }
       else           ret+= 0xFA;
     }
   else
     {
-      if ( cflag ) { ret+= 0xA0; _regs.CCR.v|= (CFLAG|XFLAG); }
+      if ( cflag ) { ret+= 0xA0; SREG.v|= (CFLAG|XFLAG); }
     }
   if ( ret ) CLEAR_FLAGS ( ZFLAG );
   
@@ -5918,6 +6579,66 @@ nbcd (
 
 
 /* Program Control Instructions ***********************************************/
+/* Es crida després de cada salt cap arrere. Si l'última iteració del
+ * bucle no ha modificat cap registre ni ha tingut efectes laterals en
+ * memòria, la següent farà exactament el mateix fins que passe alguna
+ * cosa fora del processador, per tant torna els cicles de totes les
+ * iteracions que caben abans del següent esdeveniment de la VDP. Si
+ * la iteració ha llegit l'estat de la VDP (esperant el VBlank, per
+ * exemple) sols es poden botar les que caben abans que l'estat canvie.
+ */
+static int
+idle_loop (
+           const int cc    /* Cicles del salt. */
+           )
+{
+  
+  MDu32 side_effects, status_reads;
+  MD_Bool poll;
+  int iter, budget, aux, n;
+  
+  
+  side_effects= MD_mem_side_effects ();
+  status_reads= MD_mem_vdp_status_reads ();
+  if ( _idle.pc != _regs.PC || _idle.side_effects != side_effects ||
+       _idle.CCR != SREG.v || _idle.USP.v != _regs._SP.v ||
+       memcmp ( _idle.D, _regs.D, sizeof(_idle.D) ) ||
+       memcmp ( _idle.A, _regs.A, sizeof(_idle.A) ) )
+    {
+      _idle.pc= _regs.PC;
+      _idle.side_effects= side_effects;
+      _idle.status_reads= status_reads;
+      _idle.CCR= SREG.v;
+      _idle.USP= _regs._SP;
+      memcpy ( _idle.D, _regs.D, sizeof(_idle.D) );
+      memcpy ( _idle.A, _regs.A, sizeof(_idle.A) );
+      _idle.cc_start= _idle.cc;
+      return 0;
+    }
+  iter= (int) (_idle.cc - _idle.cc_start);
+  _idle.cc_start= _idle.cc;
+  poll= (_idle.status_reads != status_reads);
+  _idle.status_reads= status_reads;
+  
+  /* No es pot botar si el Z80 pot canviar la memòria mentre tant. */
+  if ( iter <= 0 || _bc.trace || _watch || MD_z80_can_modify_68k () )
+    return 0;
+  budget= MD_vdp_cc_to_next_event () - _slice.cc - cc;
+  if ( poll )
+    {
+      aux= MD_vdp_cc_to_status_change () - _slice.cc - cc;
+      if ( aux < budget ) budget= aux;
+    }
+  if ( budget > IDLE_MAX_CC ) budget= IDLE_MAX_CC;
+  if ( budget < iter ) return 0;
+  n= budget/iter;
+  _idle.cc_start+= n*iter;
+  
+  return n*iter;
+  
+} /* end idle_loop */
+
+
 /* Totes les condicions. */
 static MD_Bool
 get_cond (
@@ -5929,31 +6650,31 @@ get_cond (
     {
     case 0x0: return MD_TRUE;
     case 0x1: return MD_FALSE;
-    case 0x2: return (!(_regs.CCR.v&CFLAG)) && (!(_regs.CCR.v&ZFLAG));
-    case 0x3: return (_regs.CCR.v&CFLAG) || (_regs.CCR.v&ZFLAG);
-    case 0x4: return !(_regs.CCR.v&CFLAG);
-    case 0x5: return ((_regs.CCR.v&CFLAG)!=0);
-    case 0x6: return !(_regs.CCR.v&ZFLAG);
-    case 0x7: return ((_regs.CCR.v&ZFLAG)!=0);
-    case 0x8: return !(_regs.CCR.v&VFLAG);
-    case 0x9: return ((_regs.CCR.v&VFLAG)!=0);
-    case 0xA: return !(_regs.CCR.v&NFLAG);
-    case 0xB: return ((_regs.CCR.v&NFLAG)!=0);
+    case 0x2: return (!(SREG.v&CFLAG)) && (!(SREG.v&ZFLAG));
+    case 0x3: return (SREG.v&CFLAG) || (SREG.v&ZFLAG);
+    case 0x4: return !(SREG.v&CFLAG);
+    case 0x5: return ((SREG.v&CFLAG)!=0);
+    case 0x6: return !get_zflag ();
+    case 0x7: return get_zflag ();
+    case 0x8: return !(SREG.v&VFLAG);
+    case 0x9: return ((SREG.v&VFLAG)!=0);
+    case 0xA: return !(SREG.v&NFLAG);
+    case 0xB: return ((SREG.v&NFLAG)!=0);
     case 0xC: return
-        ((_regs.CCR.v&NFLAG) && (_regs.CCR.v&VFLAG)) ||
-        ((!(_regs.CCR.v&NFLAG)) && (!(_regs.CCR.v&VFLAG)));
+        ((SREG.v&NFLAG) && (SREG.v&VFLAG)) ||
+        ((!(SREG.v&NFLAG)) && (!(SREG.v&VFLAG)));
     case 0xD: return
-        ((_regs.CCR.v&NFLAG) && (!(_regs.CCR.v&VFLAG))) ||
-        ((!(_regs.CCR.v&NFLAG)) && (_regs.CCR.v&VFLAG));
+        ((SREG.v&NFLAG) && (!(SREG.v&VFLAG))) ||
+        ((!(SREG.v&NFLAG)) && (SREG.v&VFLAG));
     case 0xE: return
-        ((_regs.CCR.v&NFLAG) && (_regs.CCR.v&VFLAG)
-         && (!(_regs.CCR.v&ZFLAG))) ||
-        ((!(_regs.CCR.v&NFLAG)) && (!(_regs.CCR.v&VFLAG))
-         && (!(_regs.CCR.v&ZFLAG)));
+        ((SREG.v&NFLAG) && (SREG.v&VFLAG)
+         && (!(SREG.v&ZFLAG))) ||
+        ((!(SREG.v&NFLAG)) && (!(SREG.v&VFLAG))
+         && (!(SREG.v&ZFLAG)));
     case 0xF: return
-        (_regs.CCR.v&ZFLAG) ||
-        ((_regs.CCR.v&NFLAG) && (!(_regs.CCR.v&VFLAG))) ||
-        ((!(_regs.CCR.v&NFLAG)) && (_regs.CCR.v&VFLAG));
+        (SREG.v&ZFLAG) ||
+        ((SREG.v&NFLAG) && (!(SREG.v&VFLAG))) ||
+        ((!(SREG.v&NFLAG)) && (SREG.v&VFLAG));
     default: return MD_FALSE; /* Açò no té que passar. */
     }
   
@@ -5968,7 +6689,7 @@ bcc (
 {
   
   
-  MDu32 newaddr;
+  MDu32 newaddr, pc;
   MD_Bool isword;
   
   
@@ -5988,8 +6709,10 @@ bcc (
   else newaddr= 0; /* CALLA!!! */
   if ( get_cond ( cond ) )
     {
+      pc= _regs.PC;
       if ( isword ) _regs.PC= newaddr;
       else _regs.PC+= (MDs8) disp;
+      if ( _idle.enabled && _regs.PC < pc ) return 10 + idle_loop ( 10 );
       return 10;
     }
   
@@ -6005,9 +6728,10 @@ bra (
 {
   
   MDs16 disp16;
-  MDu32 addr;
+  MDu32 addr, pc;
   
   
+  pc= _regs.PC;
   if ( disp==0x00 )
     {
       addr= _regs.PC;
@@ -6015,6 +6739,7 @@ bra (
       _regs.PC= addr + disp16;
     }
   else _regs.PC+= (MDs8) disp;
+  if ( _idle.enabled && _regs.PC < pc ) return 10 + idle_loop ( 10 );
   
   return 10;
   
@@ -6171,7 +6896,7 @@ static int
 rtr (void)
 {
   
-  _regs.CCR.b.v0= MD_mem_read ( _regs.A[7].v ).b.v0&0x1F;
+  SREG.b.v0= MD_mem_read ( _regs.A[7].v ).b.v0&0x1F;
   _regs.A[7].v+= 2;
   _regs.PC= read_long ( _regs.A[7].v ).v;
   _regs.A[7].v+= 4;
@@ -6299,10 +7024,7 @@ tstb (
       break;
     default: byte= ret= 0; /* CALLA*/ break;
     }
-  CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    ((byte&0x80)?NFLAG:0) |
-    (byte?0:ZFLAG);
+  set_lazy_flags ( LF_LOGB, 0, 0, byte );
   
   return ret;
   
@@ -6350,10 +7072,7 @@ tstl (
       break;
     default: val.v= ret= 0; /* CALLA*/ break;
     }
-  CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    ((val.v&0x80000000)?NFLAG:0) |
-    (val.v?0:ZFLAG);
+  set_lazy_flags ( LF_LOGL, 0, 0, val.v );
   
   return ret;
   
@@ -6401,10 +7120,7 @@ tstw (
       break;
     default: word.v= ret= 0; /* CALLA*/ break;
     }
-  CLEAR_FLAGS ( NFLAG|ZFLAG|VFLAG|CFLAG );
-  _regs.CCR.v|=
-    ((word.v&0x8000)?NFLAG:0) |
-    (word.v?0:ZFLAG);
+  set_lazy_flags ( LF_LOGW, 0, 0, word.v );
   
   return ret;
   
@@ -6419,7 +7135,7 @@ check_supervisor_changed (void)
   MD_Reg32 tmp;
   
   
-  if ( !(_regs.CCR.v&SFLAG) )
+  if ( !(SREG.v&SFLAG) )
     {
       tmp= _regs.A[7];
       _regs.A[7]= _regs._SP;
@@ -6433,7 +7149,7 @@ static int
 andi_to_ccr (void)
 {
   
-  _regs.CCR.b.v0&= inm_word ().b.v0;
+  SREG.b.v0&= inm_word ().b.v0;
   
   return 20;
   
@@ -6444,9 +7160,9 @@ static int
 andi_to_sr (void)
 {
   
-  if ( _regs.CCR.v&SFLAG )
+  if ( SREG.v&SFLAG )
     {
-      _regs.CCR.v&= inm_word ().v;
+      SREG.v&= inm_word ().v;
       check_supervisor_changed ();
       return 20;
     }
@@ -6471,7 +7187,7 @@ chk (
   
   if ( ((MDs16) _regs.D[reg].w.v0.v) < 0 )
     {
-      _regs.CCR.v|= NFLAG;
+      SREG.v|= NFLAG;
       return trap ( 0x018 );
     }
   switch ( eamode )
@@ -6526,7 +7242,7 @@ static int
 eori_to_ccr (void)
 {
   
-  _regs.CCR.b.v0= (_regs.CCR.b.v0^inm_word ().b.v0)&IBITS_CCR;
+  SREG.b.v0= (SREG.b.v0^inm_word ().b.v0)&IBITS_CCR;
   
   return 20;
   
@@ -6537,9 +7253,9 @@ static int
 eori_to_sr (void)
 {
   
-  if ( _regs.CCR.v&SFLAG )
+  if ( SREG.v&SFLAG )
     {
-      _regs.CCR.v= (_regs.CCR.v^inm_word ().v)&IBITS;
+      SREG.v= (SREG.v^inm_word ().v)&IBITS;
       check_supervisor_changed ();
       return 20;
     }
@@ -6560,7 +7276,7 @@ move_to_sr (
   MDu32 addr;
   
   
-  if ( !(_regs.CCR.v&SFLAG) ) return trap ( 0x020 );
+  if ( !(SREG.v&SFLAG) ) return trap ( 0x020 );
   switch ( mode )
     {
     case 0: word= _regs.D[reg].w.v0; ret= 12; break;
@@ -6598,7 +7314,7 @@ move_to_sr (
       _warning ( _udata, "MOVE to SR no accepta mode %d", mode );
       return UTIME;
     }
-  _regs.CCR.v= word.v&IBITS;
+  SREG.v= word.v&IBITS;
   check_supervisor_changed ();
   
   return ret;
@@ -6612,7 +7328,7 @@ move_to_usp (
              )
 {
   
-  if ( _regs.CCR.v&SFLAG )
+  if ( SREG.v&SFLAG )
     {
       _regs._SP= _regs.A[reg];
       return 4;
@@ -6628,7 +7344,7 @@ move_from_usp (
                )
 {
   
-  if ( _regs.CCR.v&SFLAG )
+  if ( SREG.v&SFLAG )
     {
       _regs.A[reg]= _regs._SP;
       return 4;
@@ -6642,7 +7358,7 @@ static int
 ori_to_ccr (void)
 {
   
-  _regs.CCR.b.v0= (_regs.CCR.b.v0|inm_word ().b.v0)&IBITS_CCR;
+  SREG.b.v0= (SREG.b.v0|inm_word ().b.v0)&IBITS_CCR;
   
   return 20;
   
@@ -6653,9 +7369,9 @@ static int
 ori_to_sr (void)
 {
   
-  if ( _regs.CCR.v&SFLAG )
+  if ( SREG.v&SFLAG )
     {
-      _regs.CCR.v= (_regs.CCR.v|inm_word ().v)&IBITS;
+      SREG.v= (SREG.v|inm_word ().v)&IBITS;
       check_supervisor_changed ();
       return 20;
     }
@@ -6668,7 +7384,7 @@ static int
 reset (void)
 {
   
-  if ( _regs.CCR.v&SFLAG )
+  if ( SREG.v&SFLAG )
     {
       MD_cpu_reset_external_devices_signal ();
       return 132;
@@ -6682,9 +7398,9 @@ static int
 rte (void)
 {
   
-  if ( _regs.CCR.v&SFLAG )
+  if ( SREG.v&SFLAG )
     {
-      _regs.CCR.v= MD_mem_read ( _regs.A[7].v ).v&IBITS;
+      SREG.v= MD_mem_read ( _regs.A[7].v ).v&IBITS;
       _regs.A[7].v+= 2;
       _regs.PC= read_long ( _regs.A[7].v ).v;
       _regs.A[7].v+= 4;
@@ -6700,9 +7416,9 @@ static int
 stop (void)
 {
   
-  if ( _regs.CCR.v&SFLAG )
+  if ( SREG.v&SFLAG )
     {
-      _regs.CCR.v= inm_word ().v&IBITS;
+      SREG.v= inm_word ().v&IBITS;
       check_supervisor_changed ();
       _stop= MD_TRUE;
       return 4;
@@ -6715,6 +7431,21 @@ stop (void)
 
 
 /* Taules de bot **************************************************************/
+/* Tots els gestors d'instrucció tenen la mateixa signatura: reben els
+ * camps de la paraula d'operació ja separats (v3 bits 11-9, v2 bits
+ * 8-6, v1 bits 5-3 i v0 bits 2-0). La taula '_insts' associa a cada
+ * paraula d'operació el seu gestor i es construeix en MD_cpu_init.
+ * Molts gestors no fan servir tots els camps, per això es marquen com
+ * a possiblement no utilitzats.
+ */
+#define INST_UNUSED __attribute__ ((unused))
+#define INST(NAME)        						\
+  static int NAME (MDu8 const v3 INST_UNUSED,MDu8 const v2 INST_UNUSED,	\
+        	   MDu8 const v1 INST_UNUSED,MDu8 const v0 INST_UNUSED)
+
+/* Byte baix de la paraula d'operació (Bcc, BRA, BSR i MOVEQ). */
+#define OPBYTE ((MDu8) (((v2&0x3)<<6)|(v1<<3)|v0))
+
 static int
 unk (
      MDu8 const op,
@@ -6733,6 +7464,388 @@ unk (
 
 
 static int
+unk_op (
+        MDu8 const op
+        )
+{
+  
+  _warning ( _udata, "l'opcode 0x%X és desconegut", op );
+  return UTIME;
+  
+} /* end unk_op */
+
+
+/* Desconegudes. */
+INST(i_unk0) { return unk ( 0x0, v3, v2, v1, v0 ); }
+INST(i_unk4) { return unk ( 0x4, v3, v2, v1, v0 ); }
+INST(i_unk5) { return unk ( 0x5, v3, v2, v1, v0 ); }
+INST(i_unk7) { return unk ( 0x7, v3, v2, v1, v0 ); }
+INST(i_unk8) { return unk ( 0x8, v3, v2, v1, v0 ); }
+INST(i_unk9) { return unk ( 0x9, v3, v2, v1, v0 ); }
+INST(i_unkB) { return unk ( 0xB, v3, v2, v1, v0 ); }
+INST(i_unkC) { return unk ( 0xC, v3, v2, v1, v0 ); }
+INST(i_unkD) { return unk ( 0xD, v3, v2, v1, v0 ); }
+INST(i_unkE) { return unk ( 0xE, v3, v2, v1, v0 ); }
+INST(i_unkA) { return unk_op ( 0xA ); }
+INST(i_unkF) { return unk_op ( 0xF ); }
+
+/* 0x0: Bit Manipulation/MOVEP/Immediate. */
+INST(i_ori_to_ccr) { return ori_to_ccr (); }
+INST(i_ori_to_sr) { return ori_to_sr (); }
+INST(i_andi_to_ccr) { return andi_to_ccr (); }
+INST(i_andi_to_sr) { return andi_to_sr (); }
+INST(i_eori_to_ccr) { return eori_to_ccr (); }
+INST(i_eori_to_sr) { return eori_to_sr (); }
+INST(i_orib) { return opbi ( v1, v0, orb ); }
+INST(i_oriw) { return opwi ( v1, v0, orw ); }
+INST(i_oril) { return opli ( v1, v0, orl ); }
+INST(i_andib) { return opbi ( v1, v0, andb ); }
+INST(i_andiw) { return opwi ( v1, v0, andw ); }
+INST(i_andil) { return opli ( v1, v0, andl ); }
+INST(i_subib) { return opbi ( v1, v0, subb ); }
+INST(i_subiw) { return opwi ( v1, v0, subw ); }
+INST(i_subil) { return opli ( v1, v0, subl ); }
+INST(i_addib) { return opbi ( v1, v0, addb ); }
+INST(i_addiw) { return opwi ( v1, v0, addw ); }
+INST(i_addil) { return opli ( v1, v0, addl ); }
+INST(i_eorib) { return opbi ( v1, v0, eor_b ); }
+INST(i_eoriw) { return opwi ( v1, v0, eor_w ); }
+INST(i_eoril) { return opli ( v1, v0, eor_l ); }
+INST(i_cmpib) { return cmpbi ( v1, v0 ); }
+INST(i_cmpiw) { return cmpwi ( v1, v0 ); }
+INST(i_cmpil) { return cmpli ( v1, v0 ); }
+INST(i_btst_inm) { return btst_inm ( v1, v0 ); }
+INST(i_bchg_inm) { return bop_inm ( v1, v0, bchg_mem, bchg_reg ); }
+INST(i_bclr_inm) { return bop_inm ( v1, v0, bclr_mem, bclr_reg ); }
+INST(i_bset_inm) { return bop_inm ( v1, v0, bset_mem, bset_reg ); }
+INST(i_btst_dn) { return btst_reg ( v3, v1, v0 ); }
+INST(i_bchg_dn) { return bop_reg ( v3, v1, v0, bchg_mem, bchg_reg ); }
+INST(i_bclr_dn) { return bop_reg ( v3, v1, v0, bclr_mem, bclr_reg ); }
+INST(i_bset_dn) { return bop_reg ( v3, v1, v0, bset_mem, bset_reg ); }
+INST(i_movepw_mem_reg) { return movepw_mem_reg ( v3, v0 ); }
+INST(i_movepl_mem_reg) { return movepl_mem_reg ( v3, v0 ); }
+INST(i_movepw_reg_mem) { return movepw_reg_mem ( v3, v0 ); }
+INST(i_movepl_reg_mem) { return movepl_reg_mem ( v3, v0 ); }
+
+/* 0x4: Miscellaneous. */
+INST(i_negxb) { return negxb ( v1, v0 ); }
+INST(i_negxw) { return negxw ( v1, v0 ); }
+INST(i_negxl) { return negxl ( v1, v0 ); }
+INST(i_clrb) { return clrb ( v1, v0 ); }
+INST(i_clrw) { return clrw ( v1, v0 ); }
+INST(i_clrl) { return clrl ( v1, v0 ); }
+INST(i_negb) { return negb ( v1, v0 ); }
+INST(i_negw) { return negw ( v1, v0 ); }
+INST(i_negl) { return negl ( v1, v0 ); }
+INST(i_notb) { return notb ( v1, v0 ); }
+INST(i_notw) { return notw ( v1, v0 ); }
+INST(i_notl) { return notl ( v1, v0 ); }
+INST(i_tstb) { return tstb ( v1, v0 ); }
+INST(i_tstw) { return tstw ( v1, v0 ); }
+INST(i_tstl) { return tstl ( v1, v0 ); }
+INST(i_nbcd) { return nbcd ( v1, v0 ); }
+INST(i_swap) { return swap ( v0 ); }
+INST(i_pea) { return pea ( v1, v0 ); }
+INST(i_extw) { return extw ( v0 ); }
+INST(i_extl) { return extl ( v0 ); }
+INST(i_movemw_reg_mem) { return movemw_reg_mem ( v1, v0 ); }
+INST(i_movemw_mem_reg) { return movemw_mem_reg ( v1, v0 ); }
+INST(i_moveml_reg_mem) { return moveml_reg_mem ( v1, v0 ); }
+INST(i_moveml_mem_reg) { return moveml_mem_reg ( v1, v0 ); }
+INST(i_move_from_sr) { return move_from_sr ( v1, v0 ); }
+INST(i_move_to_ccr) { return move_to_ccr ( v1, v0 ); }
+INST(i_move_to_sr) { return move_to_sr ( v1, v0 ); }
+INST(i_trap) { return trap ( ((((v1&0x1)<<3)|v0)+32)<<2 ); }
+INST(i_illegal) { return trap ( 0x10 ); }
+INST(i_link) { return link ( v0 ); }
+INST(i_unlk) { return unlk ( v0 ); }
+INST(i_move_to_usp) { return move_to_usp ( v0 ); }
+INST(i_move_from_usp) { return move_from_usp ( v0 ); }
+INST(i_reset) { return reset (); }
+INST(i_nop) { return nop (); }
+INST(i_stop) { return stop (); }
+INST(i_rte) { return rte (); }
+INST(i_rts) { return rts (); }
+INST(i_rtr) { return rtr (); }
+INST(i_jsr) { return jsr ( v1, v0 ); }
+INST(i_jmp) { return jmp ( v1, v0 ); }
+INST(i_chk) { return chk ( v3, v1, v0 ); }
+INST(i_lea) { return lea ( v3, v1, v0 ); }
+
+/* 0x5: ADDQ/SUBQ/Scc/DBcc. */
+INST(i_addqb) { return opbq ( v3, v1, v0, addb ); }
+INST(i_addqw) { return opwq ( v3, v1, v0, addw, add ); }
+INST(i_addql) { return oplq ( v3, v1, v0, addl, add ); }
+INST(i_subqb) { return opbq ( v3, v1, v0, subb ); }
+INST(i_subqw) { return opwq ( v3, v1, v0, subw, sub ); }
+INST(i_subql) { return oplq ( v3, v1, v0, subl, sub ); }
+INST(i_dbcc) { return dbcc ( (v3<<1)|(v2>>2), v0 ); }
+INST(i_scc) { return scc ( (v3<<1)|(v2>>2), v1, v0 ); }
+
+/* 0x6: Bcc/BSR/BRA. La condició es coneix en construir la taula. */
+INST(i_bra) { return bra ( OPBYTE ); }
+INST(i_bsr) { return bsr ( OPBYTE ); }
+INST(i_bhi) { return bcc ( 0x2, OPBYTE ); }
+INST(i_bls) { return bcc ( 0x3, OPBYTE ); }
+INST(i_bcc) { return bcc ( 0x4, OPBYTE ); }
+INST(i_bcs) { return bcc ( 0x5, OPBYTE ); }
+INST(i_bne) { return bcc ( 0x6, OPBYTE ); }
+INST(i_beq) { return bcc ( 0x7, OPBYTE ); }
+INST(i_bvc) { return bcc ( 0x8, OPBYTE ); }
+INST(i_bvs) { return bcc ( 0x9, OPBYTE ); }
+INST(i_bpl) { return bcc ( 0xA, OPBYTE ); }
+INST(i_bmi) { return bcc ( 0xB, OPBYTE ); }
+INST(i_bge) { return bcc ( 0xC, OPBYTE ); }
+INST(i_blt) { return bcc ( 0xD, OPBYTE ); }
+INST(i_bgt) { return bcc ( 0xE, OPBYTE ); }
+INST(i_ble) { return bcc ( 0xF, OPBYTE ); }
+
+/* 0x7: MOVEQ. */
+INST(i_moveq)
+{
+  
+  _regs.D[v3].v= (MDs8) OPBYTE;
+  movel_setflags ( _regs.D[v3] );
+  
+  return 4;
+  
+} /* end i_moveq */
+
+/* 0x8: OR/DIV/SBCD. */
+INST(i_orb_easrc) { return opb_easrc ( v3, v1, v0, orb ); }
+INST(i_orw_easrc) { return opw_easrc ( v3, v1, v0, orw ); }
+INST(i_orl_easrc) { return opl_easrc ( v3, v1, v0, orl ); }
+INST(i_orb_eadst) { return opb_eadst ( v3, v1, v0, orb ); }
+INST(i_orw_eadst) { return opw_eadst ( v3, v1, v0, orw ); }
+INST(i_orl_eadst) { return opl_eadst ( v3, v1, v0, orl ); }
+INST(i_divu) { return divu ( v3, v1, v0 ); }
+INST(i_divs) { return divs ( v3, v1, v0 ); }
+INST(i_sbcd_A) { return opbx_A ( v3, v0, sbcd_op ); }
+INST(i_sbcd)
+{
+  
+  _regs.D[v3].b.v0= sbcd_op ( _regs.D[v0].b.v0, _regs.D[v3].b.v0 );
+  
+  return 6;
+  
+} /* end i_sbcd */
+
+/* 0x9: SUB/SUBX. */
+INST(i_subb_easrc) { return opb_easrc ( v3, v1, v0, subb ); }
+INST(i_subw_easrc) { return opw_easrc ( v3, v1, v0, subw ); }
+INST(i_subl_easrc) { return opl_easrc ( v3, v1, v0, subl ); }
+INST(i_subb_eadst) { return opb_eadst ( v3, v1, v0, subb ); }
+INST(i_subw_eadst) { return opw_eadst ( v3, v1, v0, subw ); }
+INST(i_subl_eadst) { return opl_eadst ( v3, v1, v0, subl ); }
+INST(i_subaw) { return opw_easrc_A ( v3, v1, v0, sub ); }
+INST(i_subal) { return opl_easrc_A ( v3, v1, v0, sub ); }
+INST(i_subxb_A) { return opbx_A ( v3, v0, subb_x ); }
+INST(i_subxw_A) { return opwx_A ( v3, v0, subw_x ); }
+INST(i_subxl_A) { return oplx_A ( v3, v0, subl_x ); }
+INST(i_subxb)
+{
+  
+  _regs.D[v3].b.v0= subb_x ( _regs.D[v0].b.v0, _regs.D[v3].b.v0 );
+  
+  return 4;
+  
+} /* end i_subxb */
+
+INST(i_subxw)
+{
+  
+  _regs.D[v3].w.v0= subw_x ( _regs.D[v0].w.v0, _regs.D[v3].w.v0 );
+  
+  return 4;
+  
+} /* end i_subxw */
+
+INST(i_subxl)
+{
+  
+  _regs.D[v3]= subl_x ( _regs.D[v0], _regs.D[v3] );
+  
+  return 8;
+  
+} /* end i_subxl */
+
+/* 0xB: CMP/EOR. */
+INST(i_cmpb) { return cmpb ( v3, v1, v0 ); }
+INST(i_cmpw) { return cmpw ( v3, v1, v0 ); }
+INST(i_cmpl) { return cmpl ( v3, v1, v0 ); }
+INST(i_cmpaw) { return cmpw_A ( v3, v1, v0 ); }
+INST(i_cmpal) { return cmpl_A ( v3, v1, v0 ); }
+INST(i_cmpmb) { return cmpmb ( v3, v0 ); }
+INST(i_cmpmw) { return cmpmw ( v3, v0 ); }
+INST(i_cmpml) { return cmpml ( v3, v0 ); }
+INST(i_eorb) { return eorb ( v3, v1, v0 ); }
+INST(i_eorw) { return eorw ( v3, v1, v0 ); }
+INST(i_eorl) { return eorl ( v3, v1, v0 ); }
+
+/* 0xC: AND/MUL/ABCD/EXG. */
+INST(i_andb_easrc) { return opb_easrc ( v3, v1, v0, andb ); }
+INST(i_andw_easrc) { return opw_easrc ( v3, v1, v0, andw ); }
+INST(i_andl_easrc) { return opl_easrc ( v3, v1, v0, andl ); }
+INST(i_andb_eadst) { return opb_eadst ( v3, v1, v0, andb ); }
+INST(i_andw_eadst) { return opw_eadst ( v3, v1, v0, andw ); }
+INST(i_andl_eadst) { return opl_eadst ( v3, v1, v0, andl ); }
+INST(i_mulu) { return mulu ( v3, v1, v0 ); }
+INST(i_muls) { return muls ( v3, v1, v0 ); }
+INST(i_abcd_A) { return opbx_A ( v3, v0, abcd_op ); }
+INST(i_abcd)
+{
+  
+  _regs.D[v3].b.v0= abcd_op ( _regs.D[v0].b.v0, _regs.D[v3].b.v0 );
+  
+  return 6;
+  
+} /* end i_abcd */
+
+INST(i_exg_dd)
+{
+  
+  MD_Reg32 tmp;
+  
+  
+  tmp= _regs.D[v3];
+  _regs.D[v3]= _regs.D[v0];
+  _regs.D[v0]= tmp;
+  
+  return 6;
+  
+} /* end i_exg_dd */
+
+INST(i_exg_aa)
+{
+  
+  MD_Reg32 tmp;
+  
+  
+  tmp= _regs.A[v3];
+  _regs.A[v3]= _regs.A[v0];
+  _regs.A[v0]= tmp;
+  
+  return 6;
+  
+} /* end i_exg_aa */
+
+INST(i_exg_da)
+{
+  
+  MD_Reg32 tmp;
+  
+  
+  tmp= _regs.D[v3];
+  _regs.D[v3]= _regs.A[v0];
+  _regs.A[v0]= tmp;
+  
+  return 6;
+  
+} /* end i_exg_da */
+
+/* 0xD: ADD/ADDX. */
+INST(i_addb_easrc) { return opb_easrc ( v3, v1, v0, addb ); }
+INST(i_addw_easrc) { return opw_easrc ( v3, v1, v0, addw ); }
+INST(i_addl_easrc) { return opl_easrc ( v3, v1, v0, addl ); }
+INST(i_addb_eadst) { return opb_eadst ( v3, v1, v0, addb ); }
+INST(i_addw_eadst) { return opw_eadst ( v3, v1, v0, addw ); }
+INST(i_addl_eadst) { return opl_eadst ( v3, v1, v0, addl ); }
+INST(i_addaw) { return opw_easrc_A ( v3, v1, v0, add ); }
+INST(i_addal) { return opl_easrc_A ( v3, v1, v0, add ); }
+INST(i_addxb_A) { return opbx_A ( v3, v0, addb_x ); }
+INST(i_addxw_A) { return opwx_A ( v3, v0, addw_x ); }
+INST(i_addxl_A) { return oplx_A ( v3, v0, addl_x ); }
+INST(i_addxb)
+{
+  
+  _regs.D[v3].b.v0= addb_x ( _regs.D[v0].b.v0, _regs.D[v3].b.v0 );
+  
+  return 4;
+  
+} /* end i_addxb */
+
+INST(i_addxw)
+{
+  
+  _regs.D[v3].w.v0= addw_x ( _regs.D[v0].w.v0, _regs.D[v3].w.v0 );
+  
+  return 4;
+  
+} /* end i_addxw */
+
+INST(i_addxl)
+{
+  
+  _regs.D[v3]= addl_x ( _regs.D[v0], _regs.D[v3] );
+  
+  return 8;
+  
+} /* end i_addxl */
+
+/* 0xE: Shift/Rotate/Bit Field. */
+INST(i_asrb_inm) { return sopb_inm ( v3, v0, asrb ); }
+INST(i_lsrb_inm) { return sopb_inm ( v3, v0, lsrb ); }
+INST(i_roxrb_inm) { return sopb_inm ( v3, v0, roxrb ); }
+INST(i_rorb_inm) { return sopb_inm ( v3, v0, rorb ); }
+INST(i_asrb_reg) { return sopb_reg ( v3, v0, asrb ); }
+INST(i_lsrb_reg) { return sopb_reg ( v3, v0, lsrb ); }
+INST(i_roxrb_reg) { return sopb_reg ( v3, v0, roxrb ); }
+INST(i_rorb_reg) { return sopb_reg ( v3, v0, rorb ); }
+INST(i_asrw_inm) { return sopw_inm ( v3, v0, asrw ); }
+INST(i_lsrw_inm) { return sopw_inm ( v3, v0, lsrw ); }
+INST(i_roxrw_inm) { return sopw_inm ( v3, v0, roxrw ); }
+INST(i_rorw_inm) { return sopw_inm ( v3, v0, rorw ); }
+INST(i_asrw_reg) { return sopw_reg ( v3, v0, asrw ); }
+INST(i_lsrw_reg) { return sopw_reg ( v3, v0, lsrw ); }
+INST(i_roxrw_reg) { return sopw_reg ( v3, v0, roxrw ); }
+INST(i_rorw_reg) { return sopw_reg ( v3, v0, rorw ); }
+INST(i_asrl_inm) { return sopl_inm ( v3, v0, asrl ); }
+INST(i_lsrl_inm) { return sopl_inm ( v3, v0, lsrl ); }
+INST(i_roxrl_inm) { return sopl_inm ( v3, v0, roxrl ); }
+INST(i_rorl_inm) { return sopl_inm ( v3, v0, rorl ); }
+INST(i_asrl_reg) { return sopl_reg ( v3, v0, asrl ); }
+INST(i_lsrl_reg) { return sopl_reg ( v3, v0, lsrl ); }
+INST(i_roxrl_reg) { return sopl_reg ( v3, v0, roxrl ); }
+INST(i_rorl_reg) { return sopl_reg ( v3, v0, rorl ); }
+INST(i_asr_mem) { return sop_mem ( v1, v0, asrw ); }
+INST(i_lsr_mem) { return sop_mem ( v1, v0, lsrw ); }
+INST(i_roxr_mem) { return sop_mem ( v1, v0, roxrw ); }
+INST(i_ror_mem) { return sop_mem ( v1, v0, rorw ); }
+INST(i_aslb_inm) { return sopb_inm ( v3, v0, aslb ); }
+INST(i_lslb_inm) { return sopb_inm ( v3, v0, lslb ); }
+INST(i_roxlb_inm) { return sopb_inm ( v3, v0, roxlb ); }
+INST(i_rolb_inm) { return sopb_inm ( v3, v0, rolb ); }
+INST(i_aslb_reg) { return sopb_reg ( v3, v0, aslb ); }
+INST(i_lslb_reg) { return sopb_reg ( v3, v0, lslb ); }
+INST(i_roxlb_reg) { return sopb_reg ( v3, v0, roxlb ); }
+INST(i_rolb_reg) { return sopb_reg ( v3, v0, rolb ); }
+INST(i_aslw_inm) { return sopw_inm ( v3, v0, aslw ); }
+INST(i_lslw_inm) { return sopw_inm ( v3, v0, lslw ); }
+INST(i_roxlw_inm) { return sopw_inm ( v3, v0, roxlw ); }
+INST(i_rolw_inm) { return sopw_inm ( v3, v0, rolw ); }
+INST(i_aslw_reg) { return sopw_reg ( v3, v0, aslw ); }
+INST(i_lslw_reg) { return sopw_reg ( v3, v0, lslw ); }
+INST(i_roxlw_reg) { return sopw_reg ( v3, v0, roxlw ); }
+INST(i_rolw_reg) { return sopw_reg ( v3, v0, rolw ); }
+INST(i_asll_inm) { return sopl_inm ( v3, v0, asll ); }
+INST(i_lsll_inm) { return sopl_inm ( v3, v0, lsll ); }
+INST(i_roxll_inm) { return sopl_inm ( v3, v0, roxll ); }
+INST(i_roll_inm) { return sopl_inm ( v3, v0, roll ); }
+INST(i_asll_reg) { return sopl_reg ( v3, v0, asll ); }
+INST(i_lsll_reg) { return sopl_reg ( v3, v0, lsll ); }
+INST(i_roxll_reg) { return sopl_reg ( v3, v0, roxll ); }
+INST(i_roll_reg) { return sopl_reg ( v3, v0, roll ); }
+INST(i_asl_mem) { return sop_mem ( v1, v0, aslw ); }
+INST(i_lsl_mem) { return sop_mem ( v1, v0, lslw ); }
+INST(i_roxl_mem) { return sop_mem ( v1, v0, roxlw ); }
+INST(i_rol_mem) { return sop_mem ( v1, v0, rolw ); }
+
+
+/* Resolució de la taula **************************************************/
+/* Les funcions següents trien el gestor d'una paraula d'operació a
+ * partir dels seus camps. Sols s'executen en construir '_insts'.
+ */
+static inst_t *
 bit_movep_inm (
                MDu8 const v3,
                MDu8 const v2,
@@ -6741,163 +7854,67 @@ bit_movep_inm (
                )
 {
   
+  MD_Bool sr;
+  
+  
+  sr= (v1==7 && v0==4);
   switch ( v2 )
     {
     case 0:
       switch ( v3 )
         {
-        case 0:
-          switch ( v1 )
-            {
-            case 7:
-              switch ( v0 )
-        	{
-        	case 4: return ori_to_ccr ();
-        	default: return opbi ( v1, v0, orb );
-        	}
-              break;
-            default: return opbi ( v1, v0, orb );
-            }
-          break;
-        case 1:
-          switch ( v1 )
-            {
-            case 7:
-              switch ( v0 )
-        	{
-        	case 4: return andi_to_ccr ();
-        	default: return opbi ( v1, v0, andb );
-        	}
-              break;
-            default: return opbi ( v1, v0, andb );
-            }
-          break;
-        case 2: return opbi ( v1, v0, subb );
-        case 3: return opbi ( v1, v0, addb );
-        case 4: return btst_inm ( v1, v0 );
-        case 5:
-          switch ( v1 )
-            {
-            case 7:
-              switch ( v0 )
-        	{
-        	case 4: return eori_to_ccr ();
-        	default: return opbi ( v1, v0, eor_b );
-        	}
-              break;
-            default: return opbi ( v1, v0, eor_b );
-            }
-          break;
-        case 6: return cmpbi ( v1, v0 );
+        case 0: return sr ? i_ori_to_ccr : i_orib;
+        case 1: return sr ? i_andi_to_ccr : i_andib;
+        case 2: return i_subib;
+        case 3: return i_addib;
+        case 4: return i_btst_inm;
+        case 5: return sr ? i_eori_to_ccr : i_eorib;
+        case 6: return i_cmpib;
         default: break;
         }
       break;
     case 1:
       switch ( v3 )
         {
-        case 0:
-          switch ( v1 )
-            {
-            case 7:
-              switch ( v0 )
-        	{
-        	case 4: return ori_to_sr ();
-        	default: return opwi ( v1, v0, orw );
-        	}
-              break;
-            default: return opwi ( v1, v0, orw );
-            }
-          break;
-        case 1:
-          switch ( v1 )
-            {
-            case 7:
-              switch ( v0 )
-        	{
-        	case 4: return andi_to_sr ();
-        	default: return opwi ( v1, v0, andw );
-        	}
-              break;
-            default: return opwi ( v1, v0, andw );
-            }
-          break;
-        case 2: return opwi ( v1, v0, subw );
-        case 3: return opwi ( v1, v0, addw );
-        case 4: return bop_inm ( v1, v0, bchg_mem, bchg_reg );
-        case 5:
-          switch ( v1 )
-            {
-            case 7:
-              switch ( v0 )
-        	{
-        	case 4: return eori_to_sr ();
-        	default: return opwi ( v1, v0, eor_w );
-        	}
-              break;
-            default: return opwi ( v1, v0, eor_w );
-            }
-          break;
-        case 6: return cmpwi ( v1, v0 );
+        case 0: return sr ? i_ori_to_sr : i_oriw;
+        case 1: return sr ? i_andi_to_sr : i_andiw;
+        case 2: return i_subiw;
+        case 3: return i_addiw;
+        case 4: return i_bchg_inm;
+        case 5: return sr ? i_eori_to_sr : i_eoriw;
+        case 6: return i_cmpiw;
         default: break;
         }
       break;
     case 2:
       switch ( v3 )
         {
-        case 0: return opli ( v1, v0, orl );
-        case 1: return opli ( v1, v0, andl );
-        case 2: return opli ( v1, v0, subl );
-        case 3: return opli ( v1, v0, addl );
-        case 4: return bop_inm ( v1, v0, bclr_mem, bclr_reg );
-        case 5: return opli ( v1, v0, eor_l );
-        case 6: return cmpli ( v1, v0 );
+        case 0: return i_oril;
+        case 1: return i_andil;
+        case 2: return i_subil;
+        case 3: return i_addil;
+        case 4: return i_bclr_inm;
+        case 5: return i_eoril;
+        case 6: return i_cmpil;
         default: break;
         }
       break;
     case 3:
-      switch ( v3 )
-        {
-        case 4: return bop_inm ( v1, v0, bset_mem, bset_reg );
-        default: break;
-        }
-      break;
-    case 4:
-      switch ( v1 )
-        {
-        case 1: return movepw_mem_reg ( v3, v0 );
-        default: return btst_reg ( v3, v1, v0 );
-        }
-      break;
-    case 5:
-      switch ( v1 )
-        {
-        case 1: return movepl_mem_reg ( v3, v0 );
-        default: return bop_reg ( v3, v1, v0, bchg_mem, bchg_reg );
-        }
-      break;
-    case 6:
-      switch ( v1 )
-        {
-        case 1: return movepw_reg_mem ( v3, v0 );
-        default: return bop_reg ( v3, v1, v0, bclr_mem, bclr_reg );
-        }
-      break;
-    case 7:
-      switch ( v1 )
-        {
-        case 1: return movepl_reg_mem ( v3, v0 );
-        default: return bop_reg ( v3, v1, v0, bset_mem, bset_reg );
-        }
+      if ( v3 == 4 ) return i_bset_inm;
       break;
+    case 4: return v1==1 ? i_movepw_mem_reg : i_btst_dn;
+    case 5: return v1==1 ? i_movepl_mem_reg : i_bchg_dn;
+    case 6: return v1==1 ? i_movepw_reg_mem : i_bclr_dn;
+    case 7: return v1==1 ? i_movepl_reg_mem : i_bset_dn;
     default: break;
     }
   
-  return unk ( 0x0, v3, v2, v1, v0 );
+  return i_unk0;
   
 } /* end bit_movep_inm */
 
 
-static int
+static inst_t *
 miscellaneous (
                MDu8 const v3,
                MDu8 const v2,
@@ -6911,48 +7928,42 @@ miscellaneous (
     case 0:
       switch ( v3 )
         {
-        case 0: return negxb ( v1, v0 );
-        case 1: return clrb ( v1, v0 );
-        case 2: return negb ( v1, v0 );
-        case 3: return notb ( v1, v0 );
-        case 4: return nbcd ( v1, v0 );
-        case 5: return tstb ( v1, v0 );
+        case 0: return i_negxb;
+        case 1: return i_clrb;
+        case 2: return i_negb;
+        case 3: return i_notb;
+        case 4: return i_nbcd;
+        case 5: return i_tstb;
         default: break;
         }
       break;
     case 1:
       switch ( v3 )
         {
-        case 0: return negxw ( v1, v0 );
-        case 1: return clrw ( v1, v0 );
-        case 2: return negw ( v1, v0 );
-        case 3: return notw ( v1, v0 );
-        case 4:
-          switch ( v1 )
-            {
-            case 0: return swap ( v0 );
-            default: return pea ( v1, v0 );
-            }
-          break;
-        case 5: return tstw ( v1, v0 );
+        case 0: return i_negxw;
+        case 1: return i_clrw;
+        case 2: return i_negw;
+        case 3: return i_notw;
+        case 4: return v1==0 ? i_swap : i_pea;
+        case 5: return i_tstw;
         case 7:
           switch ( v1 )
             {
-            case 0: return trap ( (v0+32)<<2 );
-            case 1: return trap ( ((v0|0x8)+32)<<2 );
-            case 2: return link ( v0 );
-            case 3: return unlk ( v0 );
-            case 4: return move_to_usp ( v0 );
-            case 5: return move_from_usp ( v0 );
+            case 0:
+            case 1: return i_trap;
+            case 2: return i_link;
+            case 3: return i_unlk;
+            case 4: return i_move_to_usp;
+            case 5: return i_move_from_usp;
             case 6:
               switch ( v0 )
         	{
-        	case 0: return reset ();
-        	case 1: return nop ();
-        	case 2: return stop ();
-        	case 3: return rte ();
-        	case 5: return rts ();
-        	case 7: return rtr ();
+        	case 0: return i_reset;
+        	case 1: return i_nop;
+        	case 2: return i_stop;
+        	case 3: return i_rte;
+        	case 5: return i_rts;
+        	case 7: return i_rtr;
         	default: break;
         	}
               break;
@@ -6965,65 +7976,43 @@ miscellaneous (
     case 2:
       switch ( v3 )
         {
-        case 0: return negxl ( v1, v0 );
-        case 1: return clrl ( v1, v0 );
-        case 2: return negl ( v1, v0 );
-        case 3: return notl ( v1, v0 );
-        case 4:
-          switch ( v1 )
-            {
-            case 0: return extw ( v0 );
-            default: return movemw_reg_mem ( v1, v0 );
-            }
-          break;
-        case 5: return tstl ( v1, v0 );
-        case 6: return movemw_mem_reg ( v1, v0 );
-        case 7: return jsr ( v1, v0 );
+        case 0: return i_negxl;
+        case 1: return i_clrl;
+        case 2: return i_negl;
+        case 3: return i_notl;
+        case 4: return v1==0 ? i_extw : i_movemw_reg_mem;
+        case 5: return i_tstl;
+        case 6: return i_movemw_mem_reg;
+        case 7: return i_jsr;
         default: break;
         }
       break;
     case 3:
       switch ( v3 )
         {
-        case 0: return move_from_sr ( v1, v0 );
-        case 2: return move_to_ccr ( v1, v0 );
-        case 3: return move_to_sr ( v1, v0 );
-        case 4:
-          switch ( v1 )
-            {
-            case 0: return extl ( v0 );
-            default: return moveml_reg_mem ( v1, v0 );
-            }
-          break;
+        case 0: return i_move_from_sr;
+        case 2: return i_move_to_ccr;
+        case 3: return i_move_to_sr;
+        case 4: return v1==0 ? i_extl : i_moveml_reg_mem;
         case 5:
-          switch ( v1 )
-            {
-            case 7:
-              switch ( v0 )
-        	{
-        	case 4: return trap ( 0x10 ); /* ILLEGAL */
-        	default: break;
-        	}
-              break;
-            default: break;
-            }
+          if ( v1 == 7 && v0 == 4 ) return i_illegal;
           break;
-        case 6: return moveml_mem_reg ( v1, v0 );
-        case 7: return jmp ( v1, v0 );
+        case 6: return i_moveml_mem_reg;
+        case 7: return i_jmp;
         default: break;
         }
       break;
-    case 6: return chk ( v3, v1, v0 );
-    case 7: return lea ( v3, v1, v0 );
+    case 6: return i_chk;
+    case 7: return i_lea;
     default: break;
     }
   
-  return unk ( 0x4, v3, v2, v1, v0 );
+  return i_unk4;
   
 } /* end miscellaneous */
 
 
-static int
+static inst_t *
 addq_subq__ (
              MDu8 const v3,
              MDu8 const v2,
@@ -7032,59 +8021,44 @@ addq_subq__ (
              )
 {
   
+  (void) v3; (void) v0;
   switch ( v2 )
     {
-    case 0: return opbq ( v3, v1, v0, addb );
-    case 1: return opwq ( v3, v1, v0, addw, add );
-    case 2: return oplq ( v3, v1, v0, addl, add );
+    case 0: return i_addqb;
+    case 1: return i_addqw;
+    case 2: return i_addql;
+    case 4: return i_subqb;
+    case 5: return i_subqw;
+    case 6: return i_subql;
     case 3:
-      switch ( v1 )
-        {
-        case 1: return dbcc ( v3<<1, v0 );
-        default: return scc ( v3<<1, v1, v0 );
-        }
-      break;
-    case 4: return opbq ( v3, v1, v0, subb );
-    case 5: return opwq ( v3, v1, v0, subw, sub );
-    case 6: return oplq ( v3, v1, v0, subl, sub );
-    case 7:
-      switch ( v1 )
-        {
-        case 1: return dbcc ( (v3<<1)|1, v0 );
-        default: return scc ( (v3<<1)|1, v1, v0 );
-        }
-      break;
+    case 7: return v1==1 ? i_dbcc : i_scc;
     default: break;
     }
   
-  return unk ( 0x5, v3, v2, v1, v0 );
+  return i_unk5;
   
 } /* end addq_subq__ */
 
 
-static int
+static inst_t *
 bcc_bsr_bra (
-             MDu8 const cond,
-             MDu8 const disp
+             MDu8 const cond
              )
 {
   
-  switch ( cond )
+  static inst_t * const insts[16]=
     {
-    case 0: return bra ( disp );
-    case 1: return bsr ( disp );
-    default: return bcc ( cond, disp );
-    }
+      i_bra, i_bsr, i_bhi, i_bls, i_bcc, i_bcs, i_bne, i_beq,
+      i_bvc, i_bvs, i_bpl, i_bmi, i_bge, i_blt, i_bgt, i_ble
+    };
   
-  _warning ( _udata, "instrucció desconeguda: %04X", (0x6<<12)|(cond<<8)|disp );
-  
-  return UTIME;
   
+  return insts[cond];
   
 } /* end bcc_bsr_bra */
 
 
-static int
+static inst_t *
 or_div_sbcd (
              MDu8 const v3,
              MDu8 const v2,
@@ -7093,52 +8067,33 @@ or_div_sbcd (
              )
 {
   
+  (void) v3; (void) v0;
   switch ( v2 )
     {
-    case 0:
-      switch ( v1 )
-        {
-        case 1: break;
-        default: return opb_easrc ( v3, v1, v0, orb );
-        }
-      break;
-    case 1:
-      switch ( v1 )
-        {
-        case 1: break;
-        default: return opw_easrc ( v3, v1, v0, orw );
-        }
-      break;
-    case 2:
-      switch ( v1 )
-        {
-        case 1: break;
-        default: return opl_easrc ( v3, v1, v0, orl );
-        }
-      break;
-    case 3: return divu ( v3, v1, v0 );
+    case 0: if ( v1 != 1 ) return i_orb_easrc; break;
+    case 1: if ( v1 != 1 ) return i_orw_easrc; break;
+    case 2: if ( v1 != 1 ) return i_orl_easrc; break;
+    case 3: return i_divu;
     case 4:
       switch ( v1 )
         {
-        case 0:
-          _regs.D[v3].b.v0= sbcd_op ( _regs.D[v0].b.v0, _regs.D[v3].b.v0 );
-          return 6;
-        case 1: return opbx_A ( v3, v0, sbcd_op );
-        default: return opb_eadst ( v3, v1, v0, orb );
+        case 0: return i_sbcd;
+        case 1: return i_sbcd_A;
+        default: return i_orb_eadst;
         }
       break;
-    case 5: return opw_eadst ( v3, v1, v0, orw );
-    case 6: return opl_eadst ( v3, v1, v0, orl );
-    case 7: return divs ( v3, v1, v0 );
+    case 5: return i_orw_eadst;
+    case 6: return i_orl_eadst;
+    case 7: return i_divs;
     default: break;
     }
   
-  return unk ( 0x8, v3, v2, v1, v0 );
+  return i_unk8;
   
 } /* end or_div_sbcd */
 
 
-static int
+static inst_t *
 sub_subx (
           MDu8 const v3,
           MDu8 const v2,
@@ -7147,52 +8102,47 @@ sub_subx (
           )
 {
   
+  (void) v3; (void) v0;
   switch ( v2 )
     {
-    case 0: return opb_easrc ( v3, v1, v0, subb );
-    case 1: return opw_easrc ( v3, v1, v0, subw );
-    case 2: return opl_easrc ( v3, v1, v0, subl );
-    case 3: return opw_easrc_A ( v3, v1, v0, sub );
+    case 0: return i_subb_easrc;
+    case 1: return i_subw_easrc;
+    case 2: return i_subl_easrc;
+    case 3: return i_subaw;
     case 4:
       switch ( v1 )
         {
-        case 0:
-          _regs.D[v3].b.v0= subb_x ( _regs.D[v0].b.v0, _regs.D[v3].b.v0 );
-          return 4;
-        case 1: return opbx_A ( v3, v0, subb_x );
-        default: return opb_eadst ( v3, v1, v0, subb );
+        case 0: return i_subxb;
+        case 1: return i_subxb_A;
+        default: return i_subb_eadst;
         }
       break;
     case 5:
       switch ( v1 )
         {
-        case 0:
-          _regs.D[v3].w.v0= subw_x ( _regs.D[v0].w.v0, _regs.D[v3].w.v0 );
-          return 4;
-        case 1: return opwx_A ( v3, v0, subw_x );
-        default: return opw_eadst ( v3, v1, v0, subw );
+        case 0: return i_subxw;
+        case 1: return i_subxw_A;
+        default: return i_subw_eadst;
         }
       break;
     case 6:
       switch ( v1 )
         {
-        case 0:
-          _regs.D[v3]= subl_x ( _regs.D[v0], _regs.D[v3] );
-          return 8;
-        case 1: return oplx_A ( v3, v0, subl_x );
-        default: return opl_eadst ( v3, v1, v0, subl );
+        case 0: return i_subxl;
+        case 1: return i_subxl_A;
+        default: return i_subl_eadst;
         }
       break;
-    case 7: return opl_easrc_A ( v3, v1, v0, sub );
+    case 7: return i_subal;
     default: break;
     }
   
-  return unk ( 0x9, v3, v2, v1, v0 );
+  return i_unk9;
   
 } /* end sub_subx */
 
 
-static int
+static inst_t *
 cmp_eor (
          MDu8 const v3,
          MDu8 const v2,
@@ -7201,43 +8151,26 @@ cmp_eor (
          )
 {
   
+  (void) v3; (void) v0;
   switch ( v2 )
     {
-    case 0: return cmpb ( v3, v1, v0 );
-    case 1: return cmpw ( v3, v1, v0 );
-    case 2: return cmpl ( v3, v1, v0 );
-    case 3: return cmpw_A ( v3, v1, v0 );
-    case 4:
-      switch ( v1 )
-        {
-        case 1: return cmpmb ( v3, v0 );
-        default: return eorb ( v3, v1, v0 );
-        }
-      break;
-    case 5:
-      switch ( v1 )
-        {
-        case 1: return cmpmw ( v3, v0 );
-        default: return eorw ( v3, v1, v0 );
-        }
-      break;
-    case 6:
-      switch ( v1 )
-        {
-        case 1: return cmpml ( v3, v0 );
-        default: return eorl ( v3, v1, v0 );
-        }
-      break;
-    case 7: return cmpl_A ( v3, v1, v0 );
+    case 0: return i_cmpb;
+    case 1: return i_cmpw;
+    case 2: return i_cmpl;
+    case 3: return i_cmpaw;
+    case 4: return v1==1 ? i_cmpmb : i_eorb;
+    case 5: return v1==1 ? i_cmpmw : i_eorw;
+    case 6: return v1==1 ? i_cmpml : i_eorl;
+    case 7: return i_cmpal;
     default: break;
     }
   
-  return unk ( 0xB, v3, v2, v1, v0 );
+  return i_unkB;
   
 } /* end cmp_eor */
 
 
-static int
+static inst_t *
 and_mul_abcd_exg (
         	  MDu8 const v3,
         	  MDu8 const v2,
@@ -7246,80 +8179,40 @@ and_mul_abcd_exg (
         	  )
 {
   
-  MD_Reg32 tmp;
-  
-  
+  (void) v3; (void) v0;
   switch ( v2 )
     {
-    case 0:
-      switch ( v1 )
-        {
-        case 1: break;
-        default: return opb_easrc ( v3, v1, v0, andb );
-        }
-      break;
-    case 1:
-      switch ( v1 )
-        {
-        case 1: break;
-        default: return opw_easrc ( v3, v1, v0, andw );
-        }
-      break;
-    case 2:
-      switch ( v1 )
-        {
-        case 1: break;
-        default: return opl_easrc ( v3, v1, v0, andl );
-        }
-      break;
-    case 3: return mulu ( v3, v1, v0 );
+    case 0: if ( v1 != 1 ) return i_andb_easrc; break;
+    case 1: if ( v1 != 1 ) return i_andw_easrc; break;
+    case 2: if ( v1 != 1 ) return i_andl_easrc; break;
+    case 3: return i_mulu;
     case 4:
       switch ( v1 )
         {
-        case 0:
-          _regs.D[v3].b.v0= abcd_op ( _regs.D[v0].b.v0, _regs.D[v3].b.v0 );
-          return 6;
-        case 1: return opbx_A ( v3, v0, abcd_op );
-        default: return opb_eadst ( v3, v1, v0, andb );
+        case 0: return i_abcd;
+        case 1: return i_abcd_A;
+        default: return i_andb_eadst;
         }
       break;
     case 5:
       switch ( v1 )
         {
-        case 0: /* EXG Dx,Dy */
-          tmp= _regs.D[v3];
-          _regs.D[v3]= _regs.D[v0];
-          _regs.D[v0]= tmp;
-          return 6;
-        case 1: /* EXG Ax,Ay */
-          tmp= _regs.A[v3];
-          _regs.A[v3]= _regs.A[v0];
-          _regs.A[v0]= tmp;
-          return 6;
-        default: return opw_eadst ( v3, v1, v0, andw );
+        case 0: return i_exg_dd;
+        case 1: return i_exg_aa;
+        default: return i_andw_eadst;
         }
       break;
-    case 6:
-      switch ( v1 )
-        {
-        case 1: /* EXG Dx,Ay */
-          tmp= _regs.D[v3];
-          _regs.D[v3]= _regs.A[v0];
-          _regs.A[v0]= tmp;
-          return 6;
-        default: return opl_eadst ( v3, v1, v0, andl );
-        }
-      break;
-    case 7: return muls ( v3, v1, v0 );
+    case 6: return v1==1 ? i_exg_da : i_andl_eadst;
+    case 7: return i_muls;
     default: break;
     }
   
-  return unk ( 0xC, v3, v2, v1, v0 );
+  return i_unkC;
   
 } /* end and_mul_abcd_exg */
 
 
-static int
+static inst_t *
 add_addx (
           MDu8 const v3,
           MDu8 const v2,
@@ -7328,52 +8221,47 @@ add_addx (
           )
 {
   
+  (void) v3; (void) v0;
   switch ( v2 )
     {
-    case 0: return opb_easrc ( v3, v1, v0, addb );
-    case 1: return opw_easrc ( v3, v1, v0, addw );
-    case 2: return opl_easrc ( v3, v1, v0, addl );
-    case 3: return opw_easrc_A ( v3, v1, v0, add );
+    case 0: return i_addb_easrc;
+    case 1: return i_addw_easrc;
+    case 2: return i_addl_easrc;
+    case 3: return i_addaw;
     case 4:
       switch ( v1 )
         {
-        case 0:
-          _regs.D[v3].b.v0= addb_x ( _regs.D[v0].b.v0, _regs.D[v3].b.v0 );
-          return 4;
-        case 1: return opbx_A ( v3, v0, addb_x );
-        default: return opb_eadst ( v3, v1, v0, addb );
+        case 0: return i_addxb;
+        case 1: return i_addxb_A;
+        default: return i_addb_eadst;
         }
       break;
     case 5:
       switch ( v1 )
         {
-        case 0:
-          _regs.D[v3].w.v0= addw_x ( _regs.D[v0].w.v0, _regs.D[v3].w.v0 );
-          return 4;
-        case 1: return opwx_A ( v3, v0, addw_x );
-        default: return opw_eadst ( v3, v1, v0, addw );
+        case 0: return i_addxw;
+        case 1: return i_addxw_A;
+        default: return i_addw_eadst;
         }
       break;
     case 6:
       switch ( v1 )
         {
-        case 0:
-          _regs.D[v3]= addl_x ( _regs.D[v0], _regs.D[v3] );
-          return 8;
-        case 1: return oplx_A ( v3, v0, addl_x );
-        default: return opl_eadst ( v3, v1, v0, addl );
+        case 0: return i_addxl;
+        case 1: return i_addxl_A;
+        default: return i_addl_eadst;
         }
       break;
-    case 7: return opl_easrc_A ( v3, v1, v0, add );
+    case 7: return i_addal;
     default: break;
     }
   
-  return unk ( 0xD, v3, v2, v1, v0 );
+  return i_unkD;
   
 } /* end add_addx */
 
 
-static int
+static inst_t *
 shift_rot_bit (
                MDu8 const v3,
                MDu8 const v2,
@@ -7382,118 +8270,260 @@ shift_rot_bit (
                )
 {
   
+  /* Indexat per v1 (tipus d'operació i origen del comptador). */
+  static inst_t * const rb[8]=
+    {
+      i_asrb_inm, i_lsrb_inm, i_roxrb_inm, i_rorb_inm,
+      i_asrb_reg, i_lsrb_reg, i_roxrb_reg, i_rorb_reg
+    };
+  static inst_t * const rw[8]=
+    {
+      i_asrw_inm, i_lsrw_inm, i_roxrw_inm, i_rorw_inm,
+      i_asrw_reg, i_lsrw_reg, i_roxrw_reg, i_rorw_reg
+    };
+  static inst_t * const rl[8]=
+    {
+      i_asrl_inm, i_lsrl_inm, i_roxrl_inm, i_rorl_inm,
+      i_asrl_reg, i_lsrl_reg, i_roxrl_reg, i_rorl_reg
+    };
+  static inst_t * const lb[8]=
+    {
+      i_aslb_inm, i_lslb_inm, i_roxlb_inm, i_rolb_inm,
+      i_aslb_reg, i_lslb_reg, i_roxlb_reg, i_rolb_reg
+    };
+  static inst_t * const lw[8]=
+    {
+      i_aslw_inm, i_lslw_inm, i_roxlw_inm, i_rolw_inm,
+      i_aslw_reg, i_lslw_reg, i_roxlw_reg, i_rolw_reg
+    };
+  static inst_t * const ll[8]=
+    {
+      i_asll_inm, i_lsll_inm, i_roxll_inm, i_roll_inm,
+      i_asll_reg, i_lsll_reg, i_roxll_reg, i_roll_reg
+    };
+  /* Indexat per v3 (sols de 0 a 3 són vàlids). */
+  static inst_t * const rmem[4]=
+    {
+      i_asr_mem, i_lsr_mem, i_roxr_mem, i_ror_mem
+    };
+  static inst_t * const lmem[4]=
+    {
+      i_asl_mem, i_lsl_mem, i_roxl_mem, i_rol_mem
+    };
+  
+  
+  (void) v0;
   switch ( v2 )
     {
-    case 0:
-      switch ( v1 )
-        {
-        case 0: return sopb_inm ( v3, v0, asrb );
-        case 1: return sopb_inm ( v3, v0, lsrb );
-        case 2: return sopb_inm ( v3, v0, roxrb );
-        case 3: return sopb_inm ( v3, v0, rorb );
-        case 4: return sopb_reg ( v3, v0, asrb );
-        case 5: return sopb_reg ( v3, v0, lsrb );
-        case 6: return sopb_reg ( v3, v0, roxrb );
-        case 7: return sopb_reg ( v3, v0, rorb );
-        default: break;
-        }
-      break;
-    case 1:
-      switch ( v1 )
-        {
-        case 0: return sopw_inm ( v3, v0, asrw );
-        case 1: return sopw_inm ( v3, v0, lsrw );
-        case 2: return sopw_inm ( v3, v0, roxrw );
-        case 3: return sopw_inm ( v3, v0, rorw );
-        case 4: return sopw_reg ( v3, v0, asrw );
-        case 5: return sopw_reg ( v3, v0, lsrw );
-        case 6: return sopw_reg ( v3, v0, roxrw );
-        case 7: return sopw_reg ( v3, v0, rorw );
-        default: break;
-        }
-      break;
-    case 2:
-      switch ( v1 )
-        {
-        case 0: return sopl_inm ( v3, v0, asrl );
-        case 1: return sopl_inm ( v3, v0, lsrl );
-        case 2: return sopl_inm ( v3, v0, roxrl );
-        case 3: return sopl_inm ( v3, v0, rorl );
-        case 4: return sopl_reg ( v3, v0, asrl );
-        case 5: return sopl_reg ( v3, v0, lsrl );
-        case 6: return sopl_reg ( v3, v0, roxrl );
-        case 7: return sopl_reg ( v3, v0, rorl );
-        default: break;
-        }
-      break;
-    case 3:
-      switch ( v3 )
-        {
-        case 0: return sop_mem ( v1, v0, asrw );
-        case 1: return sop_mem ( v1, v0, lsrw );
-        case 2: return sop_mem ( v1, v0, roxrw );
-        case 3: return sop_mem ( v1, v0, rorw );
-        default: break;
-        }
-      break;
-    case 4:
-      switch ( v1 )
-        {
-        case 0: return sopb_inm ( v3, v0, aslb );
-        case 1: return sopb_inm ( v3, v0, lslb );
-        case 2: return sopb_inm ( v3, v0, roxlb );
-        case 3: return sopb_inm ( v3, v0, rolb );
-        case 4: return sopb_reg ( v3, v0, aslb );
-        case 5: return sopb_reg ( v3, v0, lslb );
-        case 6: return sopb_reg ( v3, v0, roxlb );
-        case 7: return sopb_reg ( v3, v0, rolb );
-        default: break;
-        }
-      break;
-    case 5:
-      switch ( v1 )
+    case 0: return rb[v1];
+    case 1: return rw[v1];
+    case 2: return rl[v1];
+    case 3: if ( v3 < 4 ) return rmem[v3]; break;
+    case 4: return lb[v1];
+    case 5: return lw[v1];
+    case 6: return ll[v1];
+    case 7: if ( v3 < 4 ) return lmem[v3]; break;
+    default: break;
+    }
+  
+  return i_unkE;
+  
+} /* end shift_rot_bit */
+
+
+static void
+init_insts (void)
+{
+  
+  int i;
+  MDu8 op,v3,v2,v1,v0;
+  inst_t *f;
+  
+  
+  for ( i= 0; i < 0x10000; ++i )
+    {
+      op= (MDu8) (i>>12);
+      v3= MD_OPV3 ( i );
+      v2= MD_OPV2 ( i );
+      v1= MD_OPV1 ( i );
+      v0= MD_OPV0 ( i );
+      switch ( op )
         {
-        case 0: return sopw_inm ( v3, v0, aslw );
-        case 1: return sopw_inm ( v3, v0, lslw );
-        case 2: return sopw_inm ( v3, v0, roxlw );
-        case 3: return sopw_inm ( v3, v0, rolw );
-        case 4: return sopw_reg ( v3, v0, aslw );
-        case 5: return sopw_reg ( v3, v0, lslw );
-        case 6: return sopw_reg ( v3, v0, roxlw );
-        case 7: return sopw_reg ( v3, v0, rolw );
-        default: break;
+        case 0x0: f= bit_movep_inm ( v3, v2, v1, v0 ); break;
+        case 0x1: f= moveb; break;
+        case 0x2: f= movel; break;
+        case 0x3: f= movew; break;
+        case 0x4: f= miscellaneous ( v3, v2, v1, v0 ); break;
+        case 0x5: f= addq_subq__ ( v3, v2, v1, v0 ); break;
+        case 0x6: f= bcc_bsr_bra ( (MDu8) ((i>>8)&0xF) ); break;
+        case 0x7: f= (i&0x0100) ? i_unk7 : i_moveq; break;
+        case 0x8: f= or_div_sbcd ( v3, v2, v1, v0 ); break;
+        case 0x9: f= sub_subx ( v3, v2, v1, v0 ); break;
+        case 0xA: f= i_unkA; break;
+        case 0xB: f= cmp_eor ( v3, v2, v1, v0 ); break;
+        case 0xC: f= and_mul_abcd_exg ( v3, v2, v1, v0 ); break;
+        case 0xD: f= add_addx ( v3, v2, v1, v0 ); break;
+        case 0xE: f= shift_rot_bit ( v3, v2, v1, v0 ); break;
+        default: f= i_unkF; break;
         }
-      break;
-    case 6:
-      switch ( v1 )
+      _insts[i]= f;
+    }
+  
+} /* end init_insts */
+
+
+/* Memòria cau de blocs *******************************************************/
+static void
+bc_flush_pool (
+               bc_pool_t *pool
+               )
+{
+  
+  memset ( pool->map, 0, sizeof(pool->map) );
+  pool->nblocks= 0;
+  pool->nops= 0;
+  _bc.block= NULL;
+  _bc.cur= _bc.end= NULL;
+  
+} /* end bc_flush_pool */
+
+
+/* Indica si la instrucció no continua mai en la següent adreça. */
+static MD_Bool
+bc_is_block_end (
+                 MD_Mnemonic const name
+                 )
+{
+  
+  switch ( name )
+    {
+    case MD_BRA:
+    case MD_JMP:
+    case MD_RTE:
+    case MD_RTR:
+    case MD_RTS:
+    case MD_TRAP:
+    case MD_ILLEGAL:
+    case MD_STOP:
+    case MD_UNK: return MD_TRUE;
+    default: return MD_FALSE;
+    }
+  
+} /* end bc_is_block_end */
+
+
+/* Descodifica el bloc que comença en PC. Les instruccions es
+ * descodifiquen fins a un salt incondicional o fins que s'ix de la
+ * zona (ROM o RAM) on comença el bloc.
+ */
+static bc_block_t *
+bc_build (
+          bc_pool_t     *pool,
+          MDu32 const    pc,
+          MD_Bool const  in_ram
+          )
+{
+  
+  bc_block_t *block;
+  bc_op_t *op;
+  MDu32 addr;
+  MDu16 opword;
+  MD_Inst inst;
+  MD_Bool end;
+  
+  
+  if ( pool->nblocks == BC_NBLOCKS || pool->nops+BC_MAX_OPS > BC_NOPS )
+    bc_flush_pool ( pool );
+  block= &(pool->blocks[pool->nblocks++]);
+  block->pc= pc;
+  block->ops= &(pool->ops[pool->nops]);
+  block->nops= 0;
+  block->in_ram= in_ram;
+  block->succ[0]= block->succ[1]= NULL;
+  
+  /* Les lectures de la descodificació no són accessos del programa. */
+  if ( _watch ) MD_mem_set_watch ( MD_FALSE );
+  addr= pc;
+  do {
+    op= &(block->ops[block->nops++]);
+    op->pc= addr;
+    opword= MD_mem_read ( addr ).v;
+    op->f= _insts[opword];
+    op->v3= MD_OPV3 ( opword );
+    op->v2= MD_OPV2 ( opword );
+    op->v1= MD_OPV1 ( opword );
+    op->v0= MD_OPV0 ( opword );
+    if ( in_ram ) MD_mem_set_ram_code ( addr );
+    addr= MD_cpu_decode ( addr, &inst );
+    end= bc_is_block_end ( inst.id.name ) || block->nops == BC_MAX_OPS ||
+      (in_ram ? (addr&0xFFFFFF) < 0xE00000 : !MD_mem_is_rom ( addr ));
+  } while ( !end );
+  if ( _watch ) MD_mem_set_watch ( MD_TRUE );
+  pool->nops+= block->nops;
+  pool->map[(pc>>1)&(BC_MAP_SIZE-1)]= block;
+  
+  return block;
+  
+} /* end bc_build */
+
+
+/* Fixa el bloc que comença en PC com el bloc actual. Primer es
+ * proven els successors del bloc anterior. Torna MD_FALSE si PC no
+ * està en ROM ni en RAM.
+ */
+static MD_Bool
+bc_lookup (
+           MDu32 const pc
+           )
+{
+  
+  bc_pool_t *pool;
+  bc_block_t *block,*prev;
+  MD_Bool in_ram;
+  
+  
+  /* Successors. */
+  prev= _bc.block;
+  if ( prev != NULL )
+    {
+      if ( prev->succ[0] != NULL && prev->succ[0]->pc == pc )
         {
-        case 0: return sopl_inm ( v3, v0, asll );
-        case 1: return sopl_inm ( v3, v0, lsll );
-        case 2: return sopl_inm ( v3, v0, roxll );
-        case 3: return sopl_inm ( v3, v0, roll );
-        case 4: return sopl_reg ( v3, v0, asll );
-        case 5: return sopl_reg ( v3, v0, lsll );
-        case 6: return sopl_reg ( v3, v0, roxll );
-        case 7: return sopl_reg ( v3, v0, roll );
-        default: break;
+          block= prev->succ[0];
+          goto found;
         }
-      break;
-    case 7:
-      switch ( v3 )
+      if ( prev->succ[1] != NULL && prev->succ[1]->pc == pc )
         {
-        case 0: return sop_mem ( v1, v0, aslw );
-        case 1: return sop_mem ( v1, v0, lslw );
-        case 2: return sop_mem ( v1, v0, roxlw );
-        case 3: return sop_mem ( v1, v0, rolw );
-        default: break;
+          block= prev->succ[1];
+          prev->succ[1]= prev->succ[0];
+          prev->succ[0]= block;
+          goto found;
         }
-      break;
-    default: break;
     }
   
-  return unk ( 0xE, v3, v2, v1, v0 );
+  /* Taula. */
+  in_ram= ((pc&0xFFFFFF) >= 0xE00000);
+  pool= in_ram ? &_bc.ram : &_bc.rom;
+  block= pool->map[(pc>>1)&(BC_MAP_SIZE-1)];
+  if ( block == NULL || block->pc != pc )
+    {
+      if ( !in_ram && !MD_mem_is_rom ( pc ) ) return MD_FALSE;
+      block= bc_build ( pool, pc, in_ram );
+      prev= _bc.block; /* bc_build pot buidar el conjunt. */
+    }
+  if ( prev != NULL && prev->in_ram == in_ram )
+    {
+      prev->succ[1]= prev->succ[0];
+      prev->succ[0]= block;
+    }
+  
+ found:
+  _bc.block= block;
+  _bc.cur= block->ops;
+  _bc.end= block->ops + block->nops;
   
-} /* end shift_rot_bit */
+  return MD_TRUE;
+  
+} /* end bc_lookup */
 
 
 
@@ -7524,6 +8554,11 @@ MD_cpu_init (
   
   _warning= warning;
   _udata= udata;
+  init_insts ();
+#ifdef MD_CPU_PROFILE
+  memset ( _prof.names, 0xFF, sizeof(_prof.names) );
+  MD_cpu_profile_reset ();
+#endif
   MD_cpu_init_state ();
   
 } /* end MD_cpu_init */
@@ -7539,6 +8574,8 @@ MD_cpu_init_state (void)
   _regs._SP.v= 0;
   _regs.PC= 0;
   _regs.CCR.v= 0;
+  _lf.op= LF_NONE;
+  _idle.pc= 0xFFFFFFFF;
   
   /* Inicialitza interrupcions externes. */
   _ints= 0;
@@ -7549,15 +8586,92 @@ MD_cpu_init_state (void)
   /* Força un RESET. */
   reset_int ();
   
+  /* Memòria cau de blocs. */
+  bc_flush_pool ( &_bc.rom );
+  bc_flush_pool ( &_bc.ram );
+  _fetch.size= 0;
+  _data.size= 0;
+  
 } /* end MD_cpu_init_state */
 
+
+void
+MD_cpu_invalidate_blocks (
+        		  const MD_Bool only_ram
+        		  )
+{
+  
+  bc_flush_pool ( &_bc.ram );
+  if ( !only_ram )
+    {
+      bc_flush_pool ( &_bc.rom );
+      _fetch.size= 0;
+      _data.size= 0;
+    }
+  
+} /* end MD_cpu_invalidate_blocks */
+
+
+#ifdef MD_CPU_PROFILE
+int
+MD_cpu_profile_dump_csv (
+        		 FILE *f
+        		 )
+{
+  
+  int i;
+  const MD_CPUProfile *p;
+  MDu64 mem_cc;
+  
+  
+  if ( fprintf ( f, "mnemonic,count,cycles,mem_cycles,alu_cycles,"
+        	 "reads,writes\n" ) < 0 )
+    return -1;
+  for ( i= 0; i < PROF_NNAMES; ++i )
+    {
+      p= &(_prof.insts[i]);
+      if ( p->count == 0 ) continue;
+      mem_cc= (p->reads + p->writes)*PROF_BUS_CC;
+      if ( mem_cc > p->cc ) mem_cc= p->cc;
+      if ( fprintf ( f, "%s,%llu,%llu,%llu,%llu,%llu,%llu\n",
+        	     _prof_names[i],
+        	     (unsigned long long) p->count,
+        	     (unsigned long long) p->cc,
+        	     (unsigned long long) mem_cc,
+        	     (unsigned long long) (p->cc-mem_cc),
+        	     (unsigned long long) p->reads,
+        	     (unsigned long long) p->writes ) < 0 )
+        return -1;
+    }
+  
+  return 0;
+  
+} /* end MD_cpu_profile_dump_csv */
+
+
+const MD_CPUProfile *
+MD_cpu_profile_get (
+        	    const MD_Mnemonic name
+        	    )
+{
+  return &(_prof.insts[name]);
+} /* end MD_cpu_profile_get */
+
+
+void
+MD_cpu_profile_reset (void)
+{
+  memset ( _prof.insts, 0, sizeof(_prof.insts) );
+} /* end MD_cpu_profile_reset */
+#endif
+
 #include <stdio.h>
 int
 MD_cpu_run (void)
 {
   
   MD_Word opword;
-  unpack_t uword;
+  const bc_op_t *op;
   int ret;
   
   
@@ -7565,39 +8679,63 @@ MD_cpu_run (void)
   if ( _regs.CCR.v&0x8000 ) printf("TRACE\n");
   if ( _ints ) { ret= interrupts (); if ( ret ) return ret; }
   if ( _stop ) return 4;
-  opword= MD_mem_read ( _regs.PC );
-  _regs.PC+= 2;
-  uword= MD_unpack__[opword.v];
-  switch ( uword.op )
-    {
-    case 0x0: return bit_movep_inm ( uword.v3, uword.v2, uword.v1, uword.v0 );
-    case 0x1: return moveb ( uword.v3, uword.v2, uword.v1, uword.v0 );
-    case 0x2: return movel ( uword.v3, uword.v2, uword.v1, uword.v0 );
-    case 0x3: return movew ( uword.v3, uword.v2, uword.v1, uword.v0 );
-    case 0x4: return miscellaneous ( uword.v3, uword.v2, uword.v1, uword.v0 );
-    case 0x5: return addq_subq__ ( uword.v3, uword.v2, uword.v1, uword.v0 );
-    case 0x6: return bcc_bsr_bra ( opword.b.v1&0xF, opword.b.v0 );
-    case 0x7: /* MOVEQ */
-      if ( opword.v&0x0100 )
-        return unk ( 0x7, uword.v3, uword.v2, uword.v1, uword.v0 );
-      _regs.D[uword.v3].v= (MDs8) opword.b.v0;
-      movel_setflags ( _regs.D[uword.v3] );
-      return 4;
-    case 0x8: return or_div_sbcd ( uword.v3, uword.v2, uword.v1, uword.v0 );
-    case 0x9: return sub_subx ( uword.v3, uword.v2, uword.v1, uword.v0 );
-    case 0xB: return cmp_eor ( uword.v3, uword.v2, uword.v1, uword.v0 );
-    case 0xC: return and_mul_abcd_exg ( uword.v3, uword.v2,
-        				uword.v1, uword.v0 );
-    case 0xD: return add_addx ( uword.v3, uword.v2, uword.v1, uword.v0 );
-    case 0xE: return shift_rot_bit ( uword.v3, uword.v2, uword.v1, uword.v0 );
-    default:
-      _warning ( _udata, "l'opcode 0x%X és desconegut", uword.op );
-      return UTIME;
+  if ( _bc.enabled && !_bc.trace &&
+       ((_bc.cur != _bc.end && _bc.cur->pc == _regs.PC) ||
+        bc_lookup ( _regs.PC )) )
+    {
+#ifdef MD_CPU_PROFILE
+      prof_begin ( MD_TRUE );
+#endif
+      op= _bc.cur++;
+      _regs.PC+= 2;
+      ret= op->f ( op->v3, op->v2, op->v1, op->v0 );
+    }
+  else
+    {
+#ifdef MD_CPU_PROFILE
+      prof_begin ( MD_FALSE );
+#endif
+      opword= fetch ( _regs.PC );
+      _regs.PC+= 2;
+      ret= _insts[opword.v] ( MD_OPV3 ( opword.v ), MD_OPV2 ( opword.v ),
+        		      MD_OPV1 ( opword.v ), MD_OPV0 ( opword.v ) );
     }
+#ifdef MD_CPU_PROFILE
+  prof_end ( ret );
+#endif
+  _idle.cc+= ret;
+  
+  return ret;
   
 } /* end MD_cpu_run */
 
 
+int
+MD_cpu_run_until (
+        	  const int   cc,
+        	  MD_CPUSync *sync
+        	  )
+{
+  
+  int total, ret;
+  
+  
+  _slice.sync= sync;
+  _slice.cc= 0;
+  _slice.stop= MD_FALSE;
+  total= 0;
+  do {
+    ret= MD_cpu_run ();
+    _slice.cc+= ret;
+    total+= ret;
+  } while ( total <= cc && !_slice.stop );
+  _slice.sync= NULL;
+  
+  return _slice.cc;
+  
+} /* end MD_cpu_run_until */
+
+
 void
 MD_cpu_set_auto_vector_int (
         		    const int num
@@ -7611,6 +8749,56 @@ MD_cpu_set_auto_vector_int (
 } /* end MD_cpu_set_auto_vector_int */
 
 
+void
+MD_cpu_set_block_cache (
+        		const MD_Bool enabled
+        		)
+{
+  
+  _bc.enabled= enabled;
+  bc_flush_pool ( &_bc.rom );
+  bc_flush_pool ( &_bc.ram );
+  
+} /* end MD_cpu_set_block_cache */
+
+
+void
+MD_cpu_set_idle_skip (
+        	      const MD_Bool enabled
+        	      )
+{
+  
+  _idle.enabled= enabled;
+  _idle.pc= 0xFFFFFFFF;
+  
+} /* end MD_cpu_set_idle_skip */
+
+
+void
+MD_cpu_set_mode_trace (
+        	       const MD_Bool val
+        	       )
+{
+  
+  _bc.trace= val;
+  _fetch.size= 0;
+  _data.size= 0;
+  
+} /* end MD_cpu_set_mode_trace */
+
+
+void
+MD_cpu_set_watch (
+        	  const MD_Bool val
+        	  )
+{
+  
+  _watch= val;
+  _data.size= 0;
+  
+} /* end MD_cpu_set_watch */
+
+
 void
 MD_cpu_set_reset (void)
 {
@@ -7618,6 +8806,25 @@ MD_cpu_set_reset (void)
 } /* end MD_cpu_set_reset */
 
 
+void
+MD_cpu_sync (void)
+{
+  
+  int cc;
+  
+  
+  if ( _slice.sync == NULL ) return;
+  _slice.stop= MD_TRUE;
+  if ( _slice.cc > 0 )
+    {
+      cc= _slice.cc;
+      _slice.cc= 0;
+      _slice.sync ( cc );
+    }
+  
+} /* end MD_cpu_sync */
+
+
 MDu32
 MD_cpu_decode_next_step (
         		 MD_Step *step
@@ -7662,6 +8869,7 @@ MD_cpu_save_state (
         	   )
 {
 
+  sync_flags ();
   SAVE ( _regs );
   SAVE ( _ints );
   SAVE ( _stop );
@@ -7678,6 +8886,10 @@ MD_cpu_load_state (
 {
 
   LOAD ( _regs );
+  _lf.op= LF_NONE;
+  _idle.pc= 0xFFFFFFFF;
+  _fetch.size= 0;
+  _data.size= 0;
   LOAD ( _ints );
   LOAD ( _stop );
 
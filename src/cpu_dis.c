@@ -27,7 +27,6 @@
 #include <stdlib.h>
 
 #include "MD.h"
-#include "unpack.h"
 
 
 
@@ -2953,28 +2952,25 @@ MD_cpu_decode (
 {
   
   MD_Word opword;
-  unpack_t uword;
+  MDu8 v3,v2,v1,v0;
   
   
   opword= MD_mem_read ( addr );
   inst->nbytes= 2;
   inst->bytes[0]= opword.b.v1; inst->bytes[1]= opword.b.v0;
   addr+= 2;
-  uword= MD_unpack__[opword.v];
-  switch ( uword.op )
+  v3= MD_OPV3 ( opword.v );
+  v2= MD_OPV2 ( opword.v );
+  v1= MD_OPV1 ( opword.v );
+  v0= MD_OPV0 ( opword.v );
+  switch ( opword.v>>12 )
     {
-    case 0x0: return bit_movep_inm ( addr, inst, uword.v3,
-        			     uword.v2, uword.v1, uword.v0 );
-    case 0x1: return moveb ( addr, inst, uword.v3, uword.v2,
-        		     uword.v1, uword.v0 );
-    case 0x2: return movel ( addr, inst, uword.v3, uword.v2,
-        		     uword.v1, uword.v0 );
-    case 0x3: return movew ( addr, inst, uword.v3, uword.v2,
-        		     uword.v1, uword.v0 );
-    case 0x4: return miscellaneous ( addr, inst, uword.v3, uword.v2,
-        			     uword.v1, uword.v0 );
-    case 0x5: return addq_subq__ ( addr, inst, uword.v3, uword.v2,
-        			   uword.v1, uword.v0 );
+    case 0x0: return bit_movep_inm ( addr, inst, v3, v2, v1, v0 );
+    case 0x1: return moveb ( addr, inst, v3, v2, v1, v0 );
+    case 0x2: return movel ( addr, inst, v3, v2, v1, v0 );
+    case 0x3: return movew ( addr, inst, v3, v2, v1, v0 );
+    case 0x4: return miscellaneous ( addr, inst, v3, v2, v1, v0 );
+    case 0x5: return addq_subq__ ( addr, inst, v3, v2, v1, v0 );
     case 0x6: return bcc_bsr_bra ( addr, inst, opword.b.v1&0xF, opword.b.v0 );
     case 0x7: /* MOVEQ */
       if ( opword.v&0x0100 ) { inst->id.name= MD_UNK; return addr; }
@@ -2982,20 +2978,14 @@ MD_cpu_decode (
       inst->id.op1= MD_INMl;
       inst->e1.longval= (MDs8) opword.b.v0;
       inst->id.op2= MD_DN;
-      inst->e2.reg= uword.v3;
+      inst->e2.reg= v3;
       return addr;
-    case 0x8: return or_div_sbcd ( addr, inst, uword.v3, uword.v2,
-        			   uword.v1, uword.v0 );
-    case 0x9: return sub_subx ( addr, inst, uword.v3, uword.v2,
-        			uword.v1, uword.v0 );
-    case 0xB: return cmp_eor ( addr, inst, uword.v3, uword.v2,
-        		       uword.v1, uword.v0 );
-    case 0xC: return and_mul_abcd_exg ( addr, inst, uword.v3, uword.v2,
-        				uword.v1, uword.v0 );
-    case 0xD: return add_addx ( addr, inst, uword.v3, uword.v2,
-        			uword.v1, uword.v0 );
-    case 0xE: return shift_rot_bit ( addr, inst, uword.v3, uword.v2,
-        			     uword.v1, uword.v0 );
+    case 0x8: return or_div_sbcd ( addr, inst, v3, v2, v1, v0 );
+    case 0x9: return sub_subx ( addr, inst, v3, v2, v1, v0 );
+    case 0xB: return cmp_eor ( addr, inst, v3, v2, v1, v0 );
+    case 0xC: return and_mul_abcd_exg ( addr, inst, v3, v2, v1, v0 );
+    case 0xD: return add_addx ( addr, inst, v3, v2, v1, v0 );
+    case 0xE: return shift_rot_bit ( addr, inst, v3, v2, v1, v0 );
     default: inst->id.name= MD_UNK;
     }
   
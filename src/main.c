@@ -40,8 +40,36 @@
    comprova cada 1/100 segons. */
 static const int CCTOCHECK= 76100;
 
+/* Cicles màxims que executa la UCP abans de passar-los a la resta de
+   xips (aproximadament una línia). */
+static const int SLICECC= 488;
+
 static const char MDSTATE[]= "MDSTATE\n";
 
+/* Instant d'un esdeveniment que no està planificat. */
+static const MDu64 NEVER= UINT64_MAX;
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+/* Fonts d'esdeveniments del planificador. Cada xip porta els seus
+ * comptadors i es posa al dia quan s'accedeix als seus registres
+ * (MD_cpu_sync), el planificador sols decideix fins a quan pot
+ * executar-se la UCP sense que passe res que l'afecte.
+ */
+typedef enum
+  {
+    SCHED_VDP= 0,   /* Següent interrupció o final de frame de la VDP. */
+    SCHED_Z80,      /* El Z80 pot escriure en el bus del 68000. */
+    SCHED_SLICE,    /* Final de la porció màxima (SLICECC). */
+    SCHED_CHECK,    /* Comprovació de senyals del frontend. */
+    SCHED_NUM
+  } sched_event_t;
+
 
 
 
@@ -61,12 +89,31 @@ static void *_udata;
 /* Callback per a la UCP. */
 static MD_CPUStep *_cpu_step;
 
+/* Callback de la pantalla i frames dibuixats des de MD_init. */
+static MD_UpdateScreen *_update_screen;
+static MDu64 _frames;
+
 /* Versió. */
 static MDu8 _version_no;
 
 // Indica que el SVP està actiu (no s'ha de guardar en l'estat)
 static MD_Bool _svp_enabled;
 
+/* Cicles passats a la resta de xips durant la porció actual. */
+static int _synced_cc;
+
+/* Planificador. Els instants són absoluts, en cicles de UCP des de
+ * MD_init. Com les fonts són poques i fixes n'hi ha prou amb una
+ * taula.
+ */
+static struct
+{
+  
+  MDu64 now;               /* Rellotge mestre. */
+  MDu64 when[SCHED_NUM];   /* Següent esdeveniment de cada font. */
+  
+} _sched;
+
 
 
 
@@ -95,12 +142,167 @@ reset (void)
 } /* end reset */
 
 
+/* La VDP la crida al final de cada frame. */
+static void
+update_screen (
+               const int  fb[],
+               void      *udata
+               )
+{
+  
+  ++_frames;
+  if ( _update_screen != NULL ) _update_screen ( fb, udata );
+  
+} /* end update_screen */
+
+
+/* Passa cicles de la UCP a la resta de xips, incloent els passos del
+   DMA mem->vram que es facen mentre tant. Torna els cicles totals. */
+static int
+clock_devices (
+               int cc
+               )
+{
+  
+  int ret;
+  
+  
+  ret= cc;
+  MD_z80_clock ( cc );
+  if ( _svp_enabled ) MD_svp_clock ( cc );
+  MD_fm_clock ( cc );
+  MD_psg_clock ( cc );
+  while ( MD_vdp_clock ( cc ) )
+    {
+      ret+= cc= MD_vdp_dma_mem2vram_step ();
+      MD_z80_clock ( cc );
+      if ( _svp_enabled ) MD_svp_clock ( cc );
+      MD_fm_clock ( cc );
+      MD_psg_clock ( cc );
+    }
+  
+  return ret;
+  
+} /* end clock_devices */
+
+
+static void
+sync_devices (
+              const int cc
+              )
+{
+  _synced_cc+= clock_devices ( cc );
+} /* end sync_devices */
+
+
+/* Planifica l'esdeveniment EV d'ací a CC cicles. */
+static void
+sched_set (
+           const sched_event_t ev,
+           const int           cc
+           )
+{
+  _sched.when[ev]= _sched.now + (MDu64) cc;
+} /* end sched_set */
+
+
+/* Cicles que falten per al següent esdeveniment planificat. */
+static int
+sched_cc_to_next (void)
+{
+  
+  MDu64 min;
+  int i;
+  
+  
+  min= _sched.when[0];
+  for ( i= 1; i < SCHED_NUM; ++i )
+    if ( _sched.when[i] < min ) min= _sched.when[i];
+  
+  return min > _sched.now ? (int) (min-_sched.now) : 0;
+  
+} /* end sched_cc_to_next */
+
+
+/* Torna cert, i el torna a planificar, si ha arribat el moment de
+ * comprovar les senyals del frontend.
+ */
+static MD_Bool
+sched_check_due (void)
+{
+  
+  if ( _sched.now < _sched.when[SCHED_CHECK] ) return MD_FALSE;
+  _sched.when[SCHED_CHECK]+= CCTOCHECK;
+  
+  return MD_TRUE;
+  
+} /* end sched_check_due */
+
+
+static void
+sched_init (void)
+{
+  
+  int i;
+  
+  
+  _sched.now= 0;
+  for ( i= 0; i < SCHED_NUM; ++i )
+    _sched.when[i]= NEVER;
+  if ( _check != NULL ) sched_set ( SCHED_CHECK, CCTOCHECK );
+  
+} /* end sched_init */
+
+
+/* Executa una porció de UCP i després la resta de xips. La porció
+   acaba abans del següent esdeveniment planificat, per tant les
+   interrupcions arriben en la mateixa instrucció que si es
+   sincronitzara després de cada instrucció. Si el Z80 pot modificar
+   la memòria del 68000 s'executa instrucció a instrucció. Torna els
+   cicles emprats. */
+static int
+run_slice (void)
+{
+  
+  int cc;
+  
+  
+  sched_set ( SCHED_VDP, MD_vdp_cc_to_next_event () );
+  if ( MD_z80_can_modify_68k () ) sched_set ( SCHED_Z80, 0 );
+  else _sched.when[SCHED_Z80]= NEVER;
+  sched_set ( SCHED_SLICE, SLICECC );
+  _synced_cc= 0;
+  cc= clock_devices ( MD_cpu_run_until ( sched_cc_to_next (),
+        				 sync_devices ) );
+  cc+= _synced_cc;
+  _sched.now+= (MDu64) cc;
+  
+  return cc;
+  
+} /* end run_slice */
+
+
 
 
 /**********************/
 /* FUNCIONS PÚBLIQUES */
 /**********************/
 
+void
+MD_clear_dirty (
+        	const MD_DirtyRegion region
+        	)
+{
+  
+  MD_DirtyMap map;
+  
+  
+  MD_get_dirty ( region, &map );
+  memset ( map.bits, 0, ((map.npages+63)/64)*sizeof(MDu64) );
+  
+} /* end MD_clear_dirty */
+
+
 void
 MD_close (void)
 {
@@ -111,6 +313,29 @@ MD_close (void)
 } /* end MD_close */
 
 
+void
+MD_get_dirty (
+              const MD_DirtyRegion  region,
+              MD_DirtyMap          *map
+              )
+{
+  
+  MD_DirtyMap aux,aux2;
+  
+  
+  switch ( region )
+    {
+    case MD_DIRTY_RAM: MD_mem_get_dirty ( map, &aux ); break;
+    case MD_DIRTY_SRAM: MD_mem_get_dirty ( &aux, map ); break;
+    case MD_DIRTY_Z80_RAM: MD_z80_get_dirty ( map ); break;
+    case MD_DIRTY_VRAM: MD_vdp_get_dirty ( map, &aux, &aux2 ); break;
+    case MD_DIRTY_CRAM: MD_vdp_get_dirty ( &aux, map, &aux2 ); break;
+    case MD_DIRTY_VSRAM: MD_vdp_get_dirty ( &aux, &aux2, map ); break;
+    }
+  
+} /* end MD_get_dirty */
+
+
 void
 MD_init (
          const MD_Rom      *rom,
@@ -126,6 +351,8 @@ MD_init (
   _udata= udata;
   _cpu_step= frontend->trace!=NULL ?
     frontend->trace->cpu_step:NULL;
+  _update_screen= frontend->update_screen;
+  _frames= 0;
   
   /* VERSION NO. */
   /* Si dixe VER a 0 m'assegure de que no fa la tonteria del TMMS. */
@@ -157,13 +384,16 @@ MD_init (
         	frontend->warning, udata );
   MD_vdp_init ( (model_flags&MD_MODEL_PAL)!=0,
         	frontend->sres_changed,
-        	frontend->update_screen,
+        	update_screen,
         	frontend->warning, udata );
   MD_vdp_set_dma_lag ( _svp_enabled ? 2 : 0 );
   MD_io_init ( frontend->plugged_devs, frontend->check_buttons, udata );
   MD_fm_init ( frontend->warning, udata );
   MD_psg_init ();
   MD_audio_init ( frontend->warning, frontend->play_sound, udata );
+  MD_watch_init ( frontend->trace!=NULL ? frontend->trace->watch_hit : NULL,
+        	  udata );
+  sched_init ();
   
 } /* end MD_init */
 
@@ -174,29 +404,12 @@ MD_iter (
          )
 {
 
-  static int CC= 0;
-  int cc, ret;
-  MD_Bool dma_mem2vram;
+  int ret;
   
   
-  ret= cc= MD_cpu_run ();
-  MD_z80_clock ( cc );
-  if ( _svp_enabled ) MD_svp_clock ( cc );
-  MD_fm_clock ( cc );
-  MD_psg_clock ( cc );
-  CC+= cc;
-  while ( (dma_mem2vram= MD_vdp_clock ( cc )) )
+  ret= run_slice ();
+  if ( sched_check_due () )
     {
-      ret+= cc= MD_vdp_dma_mem2vram_step ();
-      MD_z80_clock ( cc );
-      if ( _svp_enabled ) MD_svp_clock ( cc );
-      MD_fm_clock ( cc );
-      MD_psg_clock ( cc );
-      CC+= cc;
-    }
-  if ( CC >= CCTOCHECK && _check != NULL )
-    {
-      CC-= CCTOCHECK;
       _check ( stop, &_reset, _udata );
       if ( _reset ) reset ();
     }
@@ -275,54 +488,22 @@ void
 MD_loop (void)
 {
   
-  int cc, CC;
-  MD_Bool dma_mem2vram;
-  
-  
   _stop= _reset= MD_FALSE;
   if ( _check == NULL )
     {
       while ( !_stop )
         {
           if ( _reset ) reset ();
-          cc= MD_cpu_run ();
-          MD_z80_clock ( cc );
-          if ( _svp_enabled ) MD_svp_clock ( cc );
-          MD_fm_clock ( cc );
-          MD_psg_clock ( cc );
-          while ( (dma_mem2vram= MD_vdp_clock ( cc )) )
-            {
-              cc= MD_vdp_dma_mem2vram_step ();
-              MD_z80_clock ( cc );
-              if ( _svp_enabled ) MD_svp_clock ( cc );
-              MD_fm_clock ( cc );
-              MD_psg_clock ( cc );
-            }
+          run_slice ();
         }
     }
   else
     {
-      CC= 0;
       for (;;)
         {
-          cc= MD_cpu_run ();
-          MD_z80_clock ( cc );
-          if ( _svp_enabled ) MD_svp_clock ( cc );
-          MD_fm_clock ( cc );
-          MD_psg_clock ( cc );
-          CC+= cc;
-          while ( (dma_mem2vram= MD_vdp_clock ( cc )) )
+          run_slice ();
+          if ( sched_check_due () )
             {
-              cc= MD_vdp_dma_mem2vram_step ();
-              MD_z80_clock ( cc );
-              if ( _svp_enabled ) MD_svp_clock ( cc );
-              MD_fm_clock ( cc );
-              MD_psg_clock ( cc );
-              CC+= cc;
-            }
-          if ( CC >= CCTOCHECK )
-            {
-              CC-= CCTOCHECK;
               _check ( &_stop, &_reset, _udata );
               if ( _stop ) break;
               if ( _reset ) reset ();
@@ -341,6 +522,33 @@ MD_version_no (void)
 } /* end MD_version_no */
 
 
+int
+MD_run_frame (
+              const int n
+              )
+{
+  
+  MDu64 end;
+  MD_Bool stop;
+  
+  
+  if ( n <= 0 ) return 0;
+  _stop= stop= MD_FALSE;
+  end= _frames + (MDu64) n;
+  while ( _frames < end && !_stop && !stop )
+    {
+      if ( _reset ) reset ();
+      run_slice ();
+      if ( sched_check_due () )
+        _check ( &stop, &_reset, _udata );
+    }
+  _stop= MD_FALSE;
+  
+  return n - (int) (end-_frames);
+  
+} /* end MD_run_frame */
+
+
 void
 MD_reset (void)
 {
@@ -371,7 +579,9 @@ MD_trace (void)
       _cpu_step ( &step, addr, _udata );
     }
   MD_mem_set_mode_trace ( MD_TRUE );
+  MD_cpu_set_mode_trace ( MD_TRUE );
   cc= MD_cpu_run ();
+  _sched.now+= (MDu64) cc;
   MD_z80_trace ( cc );
   if ( _svp_enabled ) MD_svp_trace ( cc );
   MD_fm_clock ( cc );
@@ -379,12 +589,14 @@ MD_trace (void)
   while ( (dma_mem2vram= MD_vdp_clock ( cc )) )
     {
       cc= MD_vdp_dma_mem2vram_step ();
+      _sched.now+= (MDu64) cc;
       MD_z80_trace ( cc );
       if ( _svp_enabled ) MD_svp_trace ( cc );
       MD_fm_clock ( cc );
       MD_psg_clock ( cc );
     }
   MD_mem_set_mode_trace ( MD_FALSE );
+  MD_cpu_set_mode_trace ( MD_FALSE );
   
   return cc;
   
@@ -49,6 +49,23 @@
 
 #define SSF2_BANK_SIZE (512*1024)
 
+/* Pàgines de 64K del bus de 24 bits. */
+#define NPAGES 256
+
+/* Blocs de 64K (en paraules 0x8000) de l'àrea de ROM (4M). */
+#define NBANKS 0x40
+#define BANK_NWORDS 0x8000
+
+/* Pàgines de 256 bytes per al seguiment de modificacions de la RAM i
+ * la SRAM. La SRAM pot ocupar fins a 4M.
+ */
+#define DIRTY_PAGE_BITS 8
+#define DIRTY_SRAM_NPAGES (0x400000>>DIRTY_PAGE_BITS)
+
+/* Marca com a modificat el byte OFF (desplaçament en bytes). */
+#define RAM_DIRTY(OFF) MD_DIRTY_SET ( _dirty_ram, (OFF)>>DIRTY_PAGE_BITS )
+#define SRAM_DIRTY(OFF) MD_DIRTY_SET ( _dirty_sram, (OFF)>>DIRTY_PAGE_BITS )
+
 
 
 
@@ -77,6 +94,74 @@ typedef struct
   MD_Bool  overlapped_enabled;
 } sram_t;
 
+/* Pàgina del mapa de memòria. Si el punter és NULL l'accés es
+ * descodifica per rangs (dispositius, SRAM, pàgines de ROM
+ * incompletes, etc.).
+ */
+typedef struct
+{
+  const MD_Word *read;     /* Lectura directa. */
+  MD_Word       *write;    /* Escriptura directa (sols la RAM). */
+} page_t;
+
+/* Bloc de 64K de l'àrea de ROM. 'nwords' és el número de paraules
+ * vàlides a partir de 'words' (menys de BANK_NWORDS si la ROM acaba a
+ * mitat del bloc, 0 si no hi ha res mapejat).
+ */
+typedef struct
+{
+  const MD_Word *words;
+  MDu32          nwords;
+} bank_t;
+
+/* Mapper del cartutx. L'únic que ha de fer un mapper és omplir
+ * '_banks' en 'reset' i cada vegada que canvia la seua configuració
+ * (després ha de cridar a 'banks_changed'). Les lectures sempre es
+ * fan a través de '_banks' i '_pages', mai a través del mapper.
+ */
+typedef struct
+{
+  
+  const char *name;
+  
+  /* Torna cert si el mapper s'ha d'utilitzar amb la ROM. */
+  MD_Bool (*probe) (const MD_Rom *rom);
+  
+  /* Torna al estat inicial i ompli '_banks'. */
+  void (*reset) (void);
+  
+  /* Escriptura de 8 bits en els registres 0xA130xx (excepte el de
+   * la SRAM). Pot ser NULL.
+   */
+  void (*write) (const MDu32 addr,const MDu8 data);
+  
+  /* Desa/Carrega l'estat. 'load_state' ha de tornar a omplir
+   * '_banks'.
+   */
+  int (*save_state) (FILE *f);
+  int (*load_state) (FILE *f);
+  
+} mapper_t;
+
+/* Estat del mapper SSF2 en els fitxers d'estat. És la disposició que
+ * tenia abans dels mappers i es conserva per a que els estats siguen
+ * compatibles. Els punters no s'utilitzen, es reconstrueixen a partir
+ * de 'ind'.
+ */
+typedef struct
+{
+
+  bool enabled;
+  int  nbanks;
+  struct
+  {
+    int            ind;
+    const MD_Word *words;
+    const MDu8    *bytes;
+  } banks[8];
+  
+} ssf2_mapper_state_t;
+
 
 
 
@@ -92,12 +177,39 @@ static MD_Bool _map_svp;
 
 static MD_Word _ram[32768]; /* 64K */
 
+/* Pàgines de 256 bytes de la RAM que contenen codi en la memòria cau
+ * de blocs del processador.
+ */
+static MDu8 _ram_code[256];
+
+/* Pàgines modificades de la RAM i la SRAM. */
+static MDu64 _dirty_ram[(65536>>DIRTY_PAGE_BITS)/64];
+static MDu64 _dirty_sram[DIRTY_SRAM_NPAGES/64];
+
+/* Comptador d'accessos amb efectes laterals: totes les escriptures i
+ * les lectures fora de la RAM i la ROM, excepte les de l'estat de la
+ * VDP, que es compten a banda.
+ */
+static MDu32 _side_effects;
+static MDu32 _vdp_status_reads;
+
 /* Callbacks. */
 static MD_Warning *_warning;
 static MD_MemAccess *_mem_access;
 static MD_MemAccess8 *_mem_access8;
 static void *_udata;
 
+/* Mode traça i punts de vigilància. */
+static MD_Bool _trace;
+static struct
+{
+  
+  MD_Bool      enabled;
+  const MDu64 *rmap;
+  const MDu64 *wmap;
+  
+} _watch;
+
 /* Funcions. */
 static MD_Word (*_mem_read) (const MDu32 addr);
 static void (*_mem_write) (const MDu32 addr,const MD_Word data);
@@ -107,19 +219,21 @@ static void (*_mem_write8) (const MDu32 addr,const MDu8 data);
 /* SRAM. */
 static sram_t _sram;
 
-// SSF2 mapper (sols s'activa per a ROM de més de 4M). Si no està
-// activitat no cal desar l'estat.
+/* Mapa de memòria. Es torna a calcular cada vegada que canvia el mapa
+ * de la ROM (SRAM, mapper).
+ */
+static page_t _pages[NPAGES];
+
+/* Mapper actiu i blocs de l'àrea de ROM que ha configurat. */
+static const mapper_t *_mapper;
+static bank_t _banks[NBANKS];
+
+// SSF2 mapper (sols s'activa per a ROM de més de 4M).
 static struct
 {
 
-  bool enabled;
-  int  nbanks; // Cada bank es de SSF2_BANK_SIZE (512KB)
-  struct
-  {
-    int            ind;
-    const MD_Word *words;
-    const MDu8    *bytes;
-  } banks[8];
+  int nbanks; // Cada bank es de SSF2_BANK_SIZE (512KB)
+  int ind[8];
   
 } _ssf2_mapper;
 
@@ -130,67 +244,239 @@ static struct
 /* FUNCIONS PRIVADES */
 /*********************/
 
+/* Es crida abans de llegir d'un dispositiu (tot el que no és RAM o
+ * ROM). Els dispositius han d'estar al dia amb el processador.
+ */
+static void
+dev_read (void)
+{
+  
+  ++_side_effects;
+  MD_cpu_sync ();
+  
+} /* end dev_read */
+
+
+/* Com dev_read però per a l'estat de la VDP. Llegir-lo sols canvia
+ * flags que tornen a tindre el mateix valor en la següent lectura.
+ */
+static void
+vdp_status_read (void)
+{
+  
+  ++_vdp_status_reads;
+  MD_cpu_sync ();
+  
+} /* end vdp_status_read */
+
+
+static void
+ram_code_written (void)
+{
+  
+  memset ( _ram_code, 0, sizeof(_ram_code) );
+  MD_cpu_invalidate_blocks ( MD_TRUE );
+  
+} /* end ram_code_written */
+
+
+static void
+update_pages (void)
+{
+  
+  int i;
+  MDu32 beg,end;
+  const MD_Word *words;
+  
+  
+  /* ROM. La SRAM activa té preferència. Els blocs incomplets es
+   * descodifiquen per rangs.
+   */
+  for ( i= 0; i < NBANKS; ++i )
+    {
+      beg= ((MDu32) i)<<16;
+      end= beg + 0x10000;
+      if ( _sram.mem != NULL &&
+           (!_sram.overlapped || _sram.overlapped_enabled) &&
+           beg < _sram.end_b && end > _sram.start_b )
+        words= NULL;
+      else if ( _banks[i].nwords == BANK_NWORDS )
+        words= _banks[i].words;
+      else words= NULL;
+      _pages[i].read= words;
+      _pages[i].write= NULL;
+    }
+  
+  /* Reserved i dispositius. */
+  for ( ; i < 0xE0; ++i )
+    {
+      _pages[i].read= NULL;
+      _pages[i].write= NULL;
+    }
+  
+  /* RAM. */
+  for ( ; i < NPAGES; ++i )
+    {
+      _pages[i].read= _ram;
+      _pages[i].write= _ram;
+    }
+  MD_z80_update_bank ();
+  
+} /* end update_pages */
+
+
+/* S'ha de cridar cada vegada que canvia el mapa de la ROM. */
 static void
-ssf2_mapper_init (
-                  const MD_Rom *rom
-                  )
+banks_changed (void)
 {
+  
+  update_pages ();
+  MD_cpu_invalidate_blocks ( MD_FALSE );
+  
+} /* end banks_changed */
+
 
+/* Mapeja NBYTES bytes de la ROM a partir de OFF (múltiple de 64K) en
+ * els blocs a partir de FIRST. La part que no arriba a la ROM es
+ * queda sense mapejar.
+ */
+static void
+map_rom (
+         const int   first,
+         const int   nbanks,
+         const MDu32 off
+         )
+{
+  
   int i;
+  MDu32 aux;
+  
+  
+  for ( i= 0; i < nbanks; ++i )
+    {
+      aux= off + (((MDu32) i)<<16);
+      if ( aux >= _rom->nbytes )
+        {
+          _banks[first+i].words= NULL;
+          _banks[first+i].nwords= 0;
+        }
+      else
+        {
+          _banks[first+i].words= &(_rom->words[aux>>1]);
+          _banks[first+i].nwords= (_rom->nbytes-aux)>>1;
+          if ( _banks[first+i].nwords > BANK_NWORDS )
+            _banks[first+i].nwords= BANK_NWORDS;
+        }
+    }
+  
+} /* end map_rom */
+
 
+/* Sense mapper: la ROM es mapeja linealment en els primers 4M. */
+static MD_Bool
+linear_mapper_probe (
+        	     const MD_Rom *rom
+        	     )
+{
+  
+  (void) rom;
+  
+  return MD_TRUE;
+  
+} /* end linear_mapper_probe */
+
+
+static void
+linear_mapper_reset (void)
+{
+  map_rom ( 0, NBANKS, 0 );
+} /* end linear_mapper_reset */
+
+
+static int
+linear_mapper_save_state (
+        		  FILE *f
+        		  )
+{
+  
+  (void) f;
+  
+  return 0;
+  
+} /* end linear_mapper_save_state */
+
+
+static int
+linear_mapper_load_state (
+        		  FILE *f
+        		  )
+{
+  
+  (void) f;
+  map_rom ( 0, NBANKS, 0 );
+  
+  return 0;
+  
+} /* end linear_mapper_load_state */
+
+
+static MD_Bool
+ssf2_mapper_probe (
+        	   const MD_Rom *rom
+        	   )
+{
   
   // NOTA!! Assumisc que sols es gasta en ROMs de més de
   // 4MB. Aparentment sols ho gasta el SSF2, i demos que hi han per
   // ahí.
   // NOTA!! Hi han demos que gasten el mapper que el binari no és
   // múltiple de 512K.
-  _ssf2_mapper.enabled=
-    rom->nbytes>=(4*1024*1024) /*&& rom->nbytes%SSF2_BANK_SIZE==0*/;
-  if ( !_ssf2_mapper.enabled ) return;
-  
-  // Inicialització. M'ho invente.
-  _ssf2_mapper.nbanks= rom->nbytes/SSF2_BANK_SIZE;
-  assert ( _ssf2_mapper.nbanks >= 8 );
-  for ( i= 0; i < 8; ++i )
-    {
-      _ssf2_mapper.banks[i].ind= i;
-      _ssf2_mapper.banks[i].words= &(rom->words[(i*SSF2_BANK_SIZE)/2]);
-      _ssf2_mapper.banks[i].bytes= &(rom->bytes[i*SSF2_BANK_SIZE]);
-    }
+  return rom->nbytes>=(4*1024*1024) /*&& rom->nbytes%SSF2_BANK_SIZE==0*/;
   
-} // end ssf2_mapper_init
+} // end ssf2_mapper_probe
 
 
-static MD_Word
-ssf2_mapper_read (
-                  const MDu32 addr
-                  )
+static void
+ssf2_mapper_map (
+        	 const int bank
+        	 )
 {
-  return _ssf2_mapper.banks[(addr>>19)&0x7].words[(addr&0x7FFFF)>>1];
-} // end ssf2_mapper_read
+  map_rom ( bank*8, 8, _ssf2_mapper.ind[bank]*SSF2_BANK_SIZE );
+} // end ssf2_mapper_map
 
 
-static MDu8
-ssf2_mapper_read8 (
-                  const MDu32 addr
-                  )
+static void
+ssf2_mapper_reset (void)
 {
-  return _ssf2_mapper.banks[(addr>>19)&0x7].bytes[addr&0x7FFFF];
-} // end ssf2_mapper_read8
+
+  int i;
+
+  
+  // Inicialització. M'ho invente.
+  _ssf2_mapper.nbanks= _rom->nbytes/SSF2_BANK_SIZE;
+  assert ( _ssf2_mapper.nbanks >= 8 );
+  for ( i= 0; i < 8; ++i )
+    {
+      _ssf2_mapper.ind[i]= i;
+      ssf2_mapper_map ( i );
+    }
+  
+} // end ssf2_mapper_reset
 
 
 static void
-ssf2_mapper_configure (
-                       const int  bank,
-                       const MDu8 val
-                       )
+ssf2_mapper_write (
+        	   const MDu32 addr,
+        	   const MDu8  val
+        	   )
 {
 
-  int ind;
+  int bank,ind;
 
 
-  if ( !_ssf2_mapper.enabled ) return;
-  
+  // Registres en 0xA130F3, 0xA130F5, ..., 0xA130FF.
+  if ( addr < 0xA130F3 || (addr&0x1) == 0 ) return;
+  bank= (addr-0xA130F1)>>1;
   ind= (int) val;
   if ( ind >= _ssf2_mapper.nbanks )
     {
@@ -198,11 +484,85 @@ ssf2_mapper_configure (
                  " bank (%d) que no està", ind );
       return;
     }
-  _ssf2_mapper.banks[bank].ind= ind;
-  _ssf2_mapper.banks[bank].words= &(_rom->words[(ind*SSF2_BANK_SIZE)/2]);
-  _ssf2_mapper.banks[bank].bytes= &(_rom->bytes[ind*SSF2_BANK_SIZE]);
+  _ssf2_mapper.ind[bank]= ind;
+  ssf2_mapper_map ( bank );
+  banks_changed ();
+  
+} // end ssf2_mapper_write
+
+
+static int
+ssf2_mapper_save_state (
+        		FILE *f
+        		)
+{
+
+  ssf2_mapper_state_t st;
+  int i;
+  
+  
+  memset ( &st, 0, sizeof(st) );
+  st.enabled= true;
+  st.nbanks= _ssf2_mapper.nbanks;
+  for ( i= 0; i < 8; ++i )
+    st.banks[i].ind= _ssf2_mapper.ind[i];
+  SAVE ( st );
+
+  return 0;
+  
+} // end ssf2_mapper_save_state
+
+
+static int
+ssf2_mapper_load_state (
+        		FILE *f
+        		)
+{
+
+  ssf2_mapper_state_t st;
+  int i;
+  
+
+  LOAD ( st );
+  CHECK ( st.enabled );
+  CHECK ( st.nbanks == (int) (_rom->nbytes/SSF2_BANK_SIZE) );
+  CHECK ( st.banks[0].ind == 0 );
+  for ( i= 0; i < 8; ++i )
+    CHECK ( st.banks[i].ind >= 0 && st.banks[i].ind < st.nbanks );
+  _ssf2_mapper.nbanks= st.nbanks;
+  for ( i= 0; i < 8; ++i )
+    {
+      _ssf2_mapper.ind[i]= st.banks[i].ind;
+      ssf2_mapper_map ( i );
+    }
+
+  return 0;
   
-} // end ssf2_mapper_configure
+} // end ssf2_mapper_load_state
+
+
+/* Mappers disponibles per ordre de preferència. El darrer sempre
+ * accepta la ROM.
+ */
+static const mapper_t MAPPERS[]=
+  {
+    {
+      "SSF2",
+      ssf2_mapper_probe,
+      ssf2_mapper_reset,
+      ssf2_mapper_write,
+      ssf2_mapper_save_state,
+      ssf2_mapper_load_state
+    },
+    {
+      "LINEAR",
+      linear_mapper_probe,
+      linear_mapper_reset,
+      NULL,
+      linear_mapper_save_state,
+      linear_mapper_load_state
+    }
+  };
 
 
 static MD_Word
@@ -214,8 +574,11 @@ mem_read (
   MDu32 aux;
   Z80u16 a16;
   MD_Word word;
+  const MD_Word *page;
   
   
+  page= _pages[(addr>>16)&0xFF].read;
+  if ( page != NULL ) return page[(addr&0xFFFF)>>1];
   aux= (addr&0xFFFFFF)>>1;
   
   /* ROM/SRAM */
@@ -225,14 +588,16 @@ mem_read (
            (!_sram.overlapped || _sram.overlapped_enabled) &&
            aux < _sram.end_w && aux >= _sram.start_w )
         return _sram.mem[aux-_sram.start_w];
-      else if ( _ssf2_mapper.enabled )
-        return ssf2_mapper_read ( addr );
-      else if ( aux < (MDu32) _rom->nwords )
-        return _rom->words[aux];
+      else if ( (aux&0x7FFF) < _banks[aux>>15].nwords )
+        return _banks[aux>>15].words[aux&0x7FFF];
       else if ( _map_svp )
-        return MD_svp_mem_read ( addr );
+        {
+          dev_read ();
+          return MD_svp_mem_read ( addr );
+        }
       else /* Assumisc que de hi haure EEPROM estarà en aquesta àrea. */
         {
+          dev_read ();
           aux= addr&0xFFFFFE;
           word.b.v1= MD_eeprom_read ( aux );
           word.b.v0= MD_eeprom_read ( aux|0x1 );
@@ -246,6 +611,7 @@ mem_read (
   /* Z80 */
   else if ( aux < 0x508000 )
     {
+      dev_read ();
       a16= addr&0xFFFE;
       word.b.v1= Z80_read ( a16 );
       word.b.v0= Z80_read ( a16|0x1 );
@@ -255,6 +621,7 @@ mem_read (
   /* I/O area. */
   else if ( aux < 0x508800 )
     {
+      dev_read ();
       /* NOTA MENTAL! Amb els registres fique word.b.v1= 0, i v0 amb
          el valor del registre. */
       switch ( aux )
@@ -312,6 +679,7 @@ mem_read (
   /* Control area. */
   else if ( aux < 0x600000 )
     {
+      dev_read ();
       switch ( aux )
         {
         case 0x508880:
@@ -328,12 +696,16 @@ mem_read (
   /* VDP area. */
   else if ( aux < 0x700000 )
     {
+      if ( aux == 0x600002 || aux == 0x600003 )
+        {
+          vdp_status_read ();
+          return MD_vdp_status ();
+        }
+      dev_read ();
       switch ( aux )
         {
         case 0x600000:
         case 0x600001: return MD_vdp_data_read ();
-        case 0x600002:
-        case 0x600003: return MD_vdp_status ();
         case 0x600004: return MD_vdp_HV ();
         default: return _zero; /* Reserved or PSG. */
         }
@@ -362,6 +734,24 @@ mem_read_trace (
 } /* end mem_read_trace */
 
 
+static MD_Word
+mem_read_watch (
+        	const MDu32 addr
+        	)
+{
+  
+  MD_Word data;
+  
+  
+  data= mem_read ( addr );
+  if ( MD_WATCH_TEST ( _watch.rmap, addr&0xFFFFFF ) )
+    MD_watch_check ( MD_WATCH_68K, MD_READ, addr&0xFFFFFF, 2, data.v );
+  
+  return data;
+  
+} /* end mem_read_watch */
+
+
 static MDu8
 mem_read8 (
            const MDu32 addr
@@ -369,8 +759,12 @@ mem_read8 (
 {
   
   MDu32 aux;
+  const MD_Word *page;
   
   
+  page= _pages[(addr>>16)&0xFF].read;
+  if ( page != NULL )
+    return ((const MDu8 *) page)[(addr&0xFFFF)^MD_BYTE_SWAP];
   aux= addr&0xFFFFFF;
   
   /* ROM/SRAM */
@@ -379,17 +773,13 @@ mem_read8 (
       if ( _sram.mem != NULL &&
            (!_sram.overlapped || _sram.overlapped_enabled) &&
            aux < _sram.end_b && aux >= _sram.start_b )
-#ifdef MD_LE
-        return ((MDu8 *) _sram.mem)[(aux-_sram.start_b)^0x1];
-#else
-        return ((MDu8 *) _sram.mem)[(aux-_sram.start_b)];
-#endif
-      else if ( _ssf2_mapper.enabled )
-        return ssf2_mapper_read8 ( addr );
-      else if ( aux < _rom->nbytes )
-        return _rom->bytes[aux];
+        return ((MDu8 *) _sram.mem)[(aux-_sram.start_b)^MD_BYTE_SWAP];
+      else if ( ((aux&0xFFFF)>>1) < _banks[aux>>16].nwords )
+        return ((const MDu8 *) _banks[aux>>16].words)
+          [(aux&0xFFFF)^MD_BYTE_SWAP];
       else if ( _map_svp )
         {
+          dev_read ();
           printf ( "Rb MD_svp_mem_read\n" );
           return 0x00;
           /*
@@ -398,18 +788,26 @@ mem_read8 (
           */
         }
       else /* Assumisc que si hi ha EEPROM estarà ací. */
-        return MD_eeprom_read ( aux );
+        {
+          dev_read ();
+          return MD_eeprom_read ( aux );
+        }
     }
   
   /* Reserved */
   else if ( aux < 0xA00000 ) return 0x00;
   
   /* Z80. */
-  else if ( aux < 0xA10000 ) return (MDu8) Z80_read ( (Z80u16) (aux&0xFFFF) );
+  else if ( aux < 0xA10000 )
+    {
+      dev_read ();
+      return (MDu8) Z80_read ( (Z80u16) (aux&0xFFFF) );
+    }
   
   /* I/O area. */
   else if ( aux < 0xA11000 )
     {
+      dev_read ();
       switch ( aux )
         {
         case 0xA10000: return 0x00;
@@ -445,6 +843,7 @@ mem_read8 (
   /* Control area. */
   else if ( aux < 0xC00000 )
     {
+      dev_read ();
       switch ( aux )
         {
         case 0xA11100: return MD_z80_busreq_read ();
@@ -459,16 +858,18 @@ mem_read8 (
   /* VDP area. */
   else if ( aux < 0xE00000 )
     {
+      if ( aux >= 0xC00004 && aux <= 0xC00007 )
+        {
+          vdp_status_read ();
+          return (aux&0x1) ? MD_vdp_status ().b.v0 : MD_vdp_status ().b.v1;
+        }
+      dev_read ();
       switch ( aux )
         {
         case 0xC00000:
         case 0xC00002: return MD_vdp_data_read ().b.v1;
         case 0xC00001:
         case 0xC00003: return MD_vdp_data_read ().b.v0;
-        case 0xC00004:
-        case 0xC00006: return MD_vdp_status ().b.v1;
-        case 0xC00005:
-        case 0xC00007: return MD_vdp_status ().b.v0;
         case 0xC00008: return MD_vdp_HV ().b.v1;
         case 0xC00009: return MD_vdp_HV ().b.v0;
         case 0xC00011: printf("Rb PSG output\n"); return 0x00;
@@ -478,11 +879,7 @@ mem_read8 (
   
   /* RAM. WORK RAM mapejada. */
   else
-#ifdef MD_LE
-    return ((MDu8 *) _ram)[(aux&0xFFFF)^0x1];
-#else
-    return ((MDu8 *) _ram)[(aux&0xFFFF)];
-#endif
+    return ((MDu8 *) _ram)[(aux&0xFFFF)^MD_BYTE_SWAP];
   
 } /* end mem_read8 */
 
@@ -504,6 +901,24 @@ mem_read8_trace (
 } /* end mem_read8_trace */
 
 
+static MDu8
+mem_read8_watch (
+        	 const MDu32 addr
+        	 )
+{
+  
+  MDu8 data;
+  
+  
+  data= mem_read8 ( addr );
+  if ( MD_WATCH_TEST ( _watch.rmap, addr&0xFFFFFF ) )
+    MD_watch_check ( MD_WATCH_68K, MD_READ, addr&0xFFFFFF, 1, data );
+  
+  return data;
+  
+} /* end mem_read8_watch */
+
+
 static void
 mem_write (
            const MDu32   addr,
@@ -513,8 +928,17 @@ mem_write (
   
   MDu32 aux;
   Z80u16 a16;
+  MD_Word *page;
   
   
+  page= _pages[(addr>>16)&0xFF].write;
+  if ( page != NULL )
+    {
+      page[(addr&0xFFFF)>>1]= data;
+      RAM_DIRTY ( addr&0xFFFF );
+      if ( _ram_code[(addr&0xFFFF)>>8] ) ram_code_written ();
+      return;
+    }
   aux= (addr&0xFFFFFF)>>1;
   
   /* SRAM */
@@ -524,9 +948,17 @@ mem_write (
            (!_sram.overlapped || _sram.overlapped_enabled) &&
            aux < _sram.end_w )
         {
-          if ( aux >= _sram.start_w ) _sram.mem[aux-_sram.start_w]= data;
+          if ( aux >= _sram.start_w )
+            {
+              _sram.mem[aux-_sram.start_w]= data;
+              SRAM_DIRTY ( (aux-_sram.start_w)<<1 );
+            }
+        }
+      else if ( _map_svp )
+        {
+          MD_cpu_sync ();
+          MD_svp_mem_write ( addr, data );
         }
-      else if ( _map_svp ) MD_svp_mem_write ( addr, data );
     }
   
   /* ROM i Reserved (Si hi ha EEPROM estarà ací). */
@@ -540,6 +972,7 @@ mem_write (
   /* Z80. */
   else if ( aux < 0x508000 )
     {
+      MD_cpu_sync ();
       a16= (Z80u16) (addr&0xFFFE);
       Z80_write ( a16, (Z80u8) data.b.v1 );
       Z80_write ( a16|0x1, (Z80u8) data.b.v0 );
@@ -548,6 +981,7 @@ mem_write (
   /* I/O area. */
   else if ( aux < 0x508800 )
     {
+      MD_cpu_sync ();
       /* NOTA MENTAL! Sols data.b.v0 es gasta. */
       switch ( aux )
         {
@@ -577,6 +1011,7 @@ mem_write (
   /* Control area. */
   else if ( aux < 0x600000 )
     {
+      MD_cpu_sync ();
       switch ( aux )
         {
         case 0x508800: printf("Ww Memory mode register\n"); break;
@@ -595,6 +1030,7 @@ mem_write (
   /* VDP area. */
   else if ( aux < 0x700000 )
     {
+      MD_cpu_sync ();
       switch ( aux )
         {
         case 0x600000:
@@ -606,7 +1042,12 @@ mem_write (
     }
   
   /* RAM. WORK RAM mapejada. */
-  else _ram[aux&0x7FFF]= data;
+  else
+    {
+      _ram[aux&0x7FFF]= data;
+      RAM_DIRTY ( (aux&0x7FFF)<<1 );
+      if ( _ram_code[(aux&0x7FFF)>>7] ) ram_code_written ();
+    }
   
 } /* end mem_write */
 
@@ -624,6 +1065,20 @@ mem_write_trace (
 } /* end mem_write_trace */
 
 
+static void
+mem_write_watch (
+        	 const MDu32   addr,
+        	 const MD_Word data
+        	 )
+{
+  
+  mem_write ( addr, data );
+  if ( MD_WATCH_TEST ( _watch.wmap, addr&0xFFFFFF ) )
+    MD_watch_check ( MD_WATCH_68K, MD_WRITE, addr&0xFFFFFF, 2, data.v );
+  
+} /* end mem_write_watch */
+
+
 static void
 mem_write8 (
             const MDu32 addr,
@@ -632,8 +1087,17 @@ mem_write8 (
 {
   
   MDu32 aux;
+  MD_Word *page;
   
   
+  page= _pages[(addr>>16)&0xFF].write;
+  if ( page != NULL )
+    {
+      ((MDu8 *) page)[(addr&0xFFFF)^MD_BYTE_SWAP]= data;
+      RAM_DIRTY ( addr&0xFFFF );
+      if ( _ram_code[(addr&0xFFFF)>>8] ) ram_code_written ();
+      return;
+    }
   aux= addr&0xFFFFFF;
   
   /* SRAM */
@@ -644,11 +1108,10 @@ mem_write8 (
            aux < _sram.end_b )
         {
           if ( aux >= _sram.start_b )
-#ifdef MD_LE
-            ((MDu8 *) _sram.mem)[(aux-_sram.start_b)^0x1]= data;
-#else
-          ((MDu8 *) _sram.mem)[(aux-_sram.start_b)]= data;
-#endif
+            {
+              ((MDu8 *) _sram.mem)[(aux-_sram.start_b)^MD_BYTE_SWAP]= data;
+              SRAM_DIRTY ( aux-_sram.start_b );
+            }
         }
       else if ( _map_svp )
         {
@@ -662,11 +1125,15 @@ mem_write8 (
   
   /* Z80. */
   else if ( aux < 0xA10000 )
-    Z80_write ( (Z80u16) (aux&0xFFFF), (Z80u8) data );
+    {
+      MD_cpu_sync ();
+      Z80_write ( (Z80u16) (aux&0xFFFF), (Z80u8) data );
+    }
   
   /* I/O area. */
   else if ( aux < 0xA11000 )
     {
+      MD_cpu_sync ();
       switch ( aux )
         {
         case 0xA10003: MD_io_data_write_1 ( data ); break;
@@ -695,23 +1162,24 @@ mem_write8 (
   /* Control area. */
   else if ( aux < 0xC00000 )
     {
+      MD_cpu_sync ();
       switch ( aux )
         {
         case 0xA11000: printf("Wb Memory mode register H\n"); break;
         case 0xA11001: printf("Wb Memory mode register L\n"); break;
         case 0xA11100: MD_z80_busreq_write ( data ); break;
         case 0xA11200: MD_z80_reset ( data ); break;
-        case 0xA130F1: _sram.overlapped_enabled= ((data&0x1)==0x1); break;
+        case 0xA130F1:
+          _sram.overlapped_enabled= ((data&0x1)==0x1);
+          if ( _sram.overlapped ) banks_changed ();
+          break;
         case 0xA15000 ... 0xA1500F:
           if ( _map_svp ) printf ( "Wb MD_svp_port_write\n" );
           break;
-        case 0xA130F3: ssf2_mapper_configure ( 1, data ); break;
-        case 0xA130F5: ssf2_mapper_configure ( 2, data ); break;
-        case 0xA130F7: ssf2_mapper_configure ( 3, data ); break;
-        case 0xA130F9: ssf2_mapper_configure ( 4, data ); break;
-        case 0xA130FB: ssf2_mapper_configure ( 5, data ); break;
-        case 0xA130FD: ssf2_mapper_configure ( 6, data ); break;
-        case 0xA130FF: ssf2_mapper_configure ( 7, data ); break;
+        case 0xA13000 ... 0xA130F0:
+        case 0xA130F2 ... 0xA130FF:
+          if ( _mapper->write != NULL ) _mapper->write ( aux, data );
+          break;
         default: break; /* TMMS o reserved. */
         }
     }
@@ -719,6 +1187,7 @@ mem_write8 (
   /* VDP area. */
   else if ( aux < 0xE00000 )
     {
+      MD_cpu_sync ();
       switch ( aux )
         {
         case 0xC00000:
@@ -732,11 +1201,11 @@ mem_write8 (
   
   /* RAM. WORK RAM mapejada. */
   else
-#ifdef MD_LE
-    ((MDu8 *) _ram)[(aux&0xFFFF)^0x1]= data;
-#else
-    ((MDu8 *) _ram)[(aux&0xFFFF)]= data;
-#endif
+    {
+      ((MDu8 *) _ram)[(aux&0xFFFF)^MD_BYTE_SWAP]= data;
+      RAM_DIRTY ( aux&0xFFFF );
+      if ( _ram_code[(aux&0xFFFF)>>8] ) ram_code_written ();
+    }
 
 } /* end mem_write8 */
 
@@ -754,6 +1223,62 @@ mem_write8_trace (
 } /* end mem_write8_trace */
 
 
+static void
+mem_write8_watch (
+        	  const MDu32 addr,
+        	  const MDu8  data
+        	  )
+{
+  
+  mem_write8 ( addr, data );
+  if ( MD_WATCH_TEST ( _watch.wmap, addr&0xFFFFFF ) )
+    MD_watch_check ( MD_WATCH_68K, MD_WRITE, addr&0xFFFFFF, 1, data );
+  
+} /* end mem_write8_watch */
+
+
+/* Tria les funcions d'accés segons el mode traça i els punts de
+ * vigilància.
+ */
+static void
+update_funcs (void)
+{
+  
+  if ( _trace && _mem_access != NULL )
+    {
+      _mem_read= mem_read_trace;
+      _mem_write= mem_write_trace;
+    }
+  else if ( _watch.enabled )
+    {
+      _mem_read= mem_read_watch;
+      _mem_write= mem_write_watch;
+    }
+  else
+    {
+      _mem_read= mem_read;
+      _mem_write= mem_write;
+    }
+  if ( _trace && _mem_access8 != NULL )
+    {
+      _mem_read8= mem_read8_trace;
+      _mem_write8= mem_write8_trace;
+    }
+  else if ( _watch.enabled )
+    {
+      _mem_read8= mem_read8_watch;
+      _mem_write8= mem_write8_watch;
+    }
+  else
+    {
+      _mem_read8= mem_read8;
+      _mem_write8= mem_write8;
+    }
+  MD_z80_update_bank ();
+  
+} /* end update_funcs */
+
+
 
 
 /**********************/
@@ -785,12 +1310,16 @@ MD_mem_init (
 
   // SVP
   _map_svp= map_svp;
+  
+  /* Mapper. */
+  for ( _mapper= &(MAPPERS[0]); !_mapper->probe ( rom ); ++_mapper );
 
   /* Funcions. */
-  _mem_read= mem_read;
-  _mem_read8= mem_read8;
-  _mem_write= mem_write;
-  _mem_write8= mem_write8;
+  _trace= MD_FALSE;
+  _watch.enabled= MD_FALSE;
+  _watch.rmap= MD_watch_get_map ( MD_WATCH_68K, MD_READ );
+  _watch.wmap= MD_watch_get_map ( MD_WATCH_68K, MD_WRITE );
+  update_funcs ();
   
   /* SRAM */
   MD_rom_get_header ( _rom, &header );
@@ -809,6 +1338,7 @@ MD_mem_init (
         }
     }
   else _sram.mem= NULL;
+  memset ( _dirty_sram, 0, sizeof(_dirty_sram) );
   
   MD_mem_init_state ();
   
@@ -820,10 +1350,15 @@ MD_mem_init_state (void)
 {
   
   memset ( _ram, 0, sizeof(MD_Word)*32768 );
+  memset ( _dirty_ram, 0xFF, sizeof(_dirty_ram) );
   _sram.overlapped_enabled= MD_FALSE;
   
-  // SSF2 mapper.
-  ssf2_mapper_init ( _rom );
+  // Mapper.
+  _mapper->reset ();
+  
+  // Memòria cau de blocs.
+  memset ( _ram_code, 0, sizeof(_ram_code) );
+  banks_changed ();
   
 } /* end MD_mem_init_state */
 
@@ -846,49 +1381,192 @@ MD_mem_read8 (
 } /* end MD_mem_read8 */
 
 
-void
-MD_mem_set_mode_trace (
-        	       const MD_Bool val
-        	       )
+MD_Bool
+MD_mem_is_rom (
+               const MDu32 addr
+               )
+{
+  
+  MDu32 aux;
+  
+  
+  aux= (addr&0xFFFFFF)>>1;
+  if ( aux >= 0x200000 ) return MD_FALSE;
+  if ( _sram.mem != NULL &&
+       (!_sram.overlapped || _sram.overlapped_enabled) &&
+       aux < _sram.end_w && aux >= _sram.start_w )
+    return MD_FALSE;
+  
+  return (aux&0x7FFF) < _banks[aux>>15].nwords;
+  
+} /* end MD_mem_is_rom */
+
+
+const MD_Word *
+MD_mem_get_code_region (
+        		const MDu32  addr,
+        		MDu32       *start,
+        		MDu32       *size
+        		)
 {
   
-  if ( _mem_access != NULL )
+  MDu32 aux,beg,end;
+  const MD_Word *words;
+  int i,first,last;
+  
+  
+  aux= addr&0xFFFFFF;
+  
+  /* RAM (repetida cada 64K). */
+  if ( aux >= 0xE00000 )
     {
-      if ( val )
-        {
-          _mem_read= mem_read_trace;
-          _mem_write= mem_write_trace;
-        }
-      else
-        {
-          _mem_read= mem_read;
-          _mem_write= mem_write;
-        }
+      *start= aux&0xFF0000;
+      *size= 0x10000;
+      return _ram;
     }
-  if ( _mem_access8 != NULL )
+  
+  /* ROM. */
+  if ( aux >= 0x400000 ) return NULL;
+  i= aux>>16;
+  if ( ((aux&0xFFFF)>>1) >= _banks[i].nwords ) return NULL;
+  
+  /* Ajunta els blocs contigus en la ROM. */
+  for ( first= i;
+        first > 0 && _banks[first-1].nwords == BANK_NWORDS &&
+          _banks[first-1].words+BANK_NWORDS == _banks[first].words;
+        --first );
+  for ( last= i;
+        last < NBANKS-1 && _banks[last].nwords == BANK_NWORDS &&
+          _banks[last+1].nwords != 0 &&
+          _banks[last].words+BANK_NWORDS == _banks[last+1].words;
+        ++last );
+  beg= ((MDu32) first)<<16;
+  end= (((MDu32) last)<<16) + (_banks[last].nwords<<1);
+  words= _banks[first].words;
+  
+  /* La SRAM activa té preferència sobre la ROM. */
+  if ( _sram.mem != NULL && (!_sram.overlapped || _sram.overlapped_enabled) )
     {
-      if ( val )
-        {
-          _mem_read8= mem_read8_trace;
-          _mem_write8= mem_write8_trace;
-        }
-      else
+      if ( aux >= _sram.start_b && aux < _sram.end_b ) return NULL;
+      if ( _sram.start_b > aux && _sram.start_b < end ) end= _sram.start_b;
+      if ( _sram.end_b <= aux && _sram.end_b > beg )
         {
-          _mem_read8= mem_read8;
-          _mem_write8= mem_write8;
+          words+= (_sram.end_b-beg)>>1;
+          beg= _sram.end_b;
         }
     }
+  *start= beg;
+  *size= end-beg;
+  
+  return words;
+  
+} /* end MD_mem_get_code_region */
+
+
+const MDu8 *
+MD_mem_get_bank_window (
+        		const MDu32 addr
+        		)
+{
+  
+  const MD_Word *page;
+  
+  
+  if ( _mem_read8 != mem_read8 ) return NULL;
+  page= _pages[(addr>>16)&0xFF].read;
+  if ( page == NULL ) return NULL;
+  
+  return ((const MDu8 *) page) + (addr&0x8000);
+  
+} /* end MD_mem_get_bank_window */
+
+
+MD_Word *
+MD_mem_get_write_span (
+        	       const MDu32 addr,
+        	       const MDu32 nbytes
+        	       )
+{
+  
+  MDu32 aux,page;
+  MD_Bool code;
+  
+  
+  aux= addr&0xFFFFFF;
+  if ( _mem_write != mem_write || nbytes == 0 || aux < 0xE00000 ||
+       (aux&0xFFFF)+nbytes > 0x10000 )
+    return NULL;
+  ++_side_effects;
+  code= MD_FALSE;
+  for ( page= (aux&0xFFFF)>>8; page <= ((aux&0xFFFF)+nbytes-1)>>8; ++page )
+    {
+      MD_DIRTY_SET ( _dirty_ram, page );
+      if ( _ram_code[page] ) code= MD_TRUE;
+    }
+  if ( code ) ram_code_written ();
+  
+  return &(_ram[(aux&0xFFFF)>>1]);
+  
+} /* end MD_mem_get_write_span */
+
+
+MDu32
+MD_mem_side_effects (void)
+{
+  return _side_effects;
+} /* end MD_mem_side_effects */
+
+
+MDu32
+MD_mem_vdp_status_reads (void)
+{
+  return _vdp_status_reads;
+} /* end MD_mem_vdp_status_reads */
+
+
+void
+MD_mem_set_ram_code (
+        	     const MDu32 addr
+        	     )
+{
+  _ram_code[(addr&0xFFFF)>>8]= 1;
+} /* end MD_mem_set_ram_code */
+
+
+void
+MD_mem_set_mode_trace (
+        	       const MD_Bool val
+        	       )
+{
+  
+  _trace= val;
+  update_funcs ();
   
 } /* end MD_mem_set_mode_trace */
 
 
+void
+MD_mem_set_watch (
+        	  const MD_Bool val
+        	  )
+{
+  
+  _watch.enabled= val;
+  update_funcs ();
+  
+} /* end MD_mem_set_watch */
+
+
 void
 MD_mem_write (
               const MDu32   addr,
               const MD_Word data
               )
 {
+  
+  ++_side_effects;
   _mem_write ( addr, data );
+  
 } /* end MD_mem_write */
 
 
@@ -898,7 +1576,10 @@ MD_mem_write8 (
                const MDu8  data
                )
 {
+  
+  ++_side_effects;
   _mem_write8 ( addr, data );
+  
 } /* end MD_mem_write8 */
 
 
@@ -916,10 +1597,7 @@ MD_mem_save_state (
       if ( fwrite ( _sram.mem, (_sram.end_w-_sram.start_w)*2, 1, f ) != 1 )
         return -1;
     }
-  if ( _ssf2_mapper.enabled )
-    {
-      SAVE ( _ssf2_mapper );
-    }
+  if ( _mapper->save_state ( f ) != 0 ) return -1;
   
   return 0;
   
@@ -932,7 +1610,7 @@ MD_mem_load_state (
         	   )
 {
 
-  int romsize,i;
+  int romsize;
   sram_t sram_tmp;
 
   
@@ -951,21 +1629,11 @@ MD_mem_load_state (
       if ( fread ( _sram.mem, (_sram.end_w-_sram.start_w)*2, 1, f ) != 1 )
         return -1;
     }
-  if ( _ssf2_mapper.enabled )
-    {
-      LOAD ( _ssf2_mapper );
-      CHECK ( _ssf2_mapper.enabled );
-      CHECK ( _ssf2_mapper.nbanks == (int) (_rom->nbytes/SSF2_BANK_SIZE) );
-      CHECK ( _ssf2_mapper.banks[0].ind == 0 );
-      for ( i= 0; i < 8; ++i )
-        {
-          CHECK ( _ssf2_mapper.banks[i].ind < _ssf2_mapper.nbanks );
-          _ssf2_mapper.banks[i].words=
-            &(_rom->words[(_ssf2_mapper.banks[i].ind*SSF2_BANK_SIZE)/2]);
-          _ssf2_mapper.banks[i].bytes=
-            &(_rom->bytes[_ssf2_mapper.banks[i].ind*SSF2_BANK_SIZE]);
-        }
-    }
+  if ( _mapper->load_state ( f ) != 0 ) return -1;
+  memset ( _ram_code, 0, sizeof(_ram_code) );
+  banks_changed ();
+  memset ( _dirty_ram, 0xFF, sizeof(_dirty_ram) );
+  memset ( _dirty_sram, 0xFF, sizeof(_dirty_sram) );
 
   return 0;
   
@@ -977,3 +1645,22 @@ MD_mem_get_ram (void)
 {
   return &_ram[0];
 } /* end MD_mem_get_ram */
+
+
+void
+MD_mem_get_dirty (
+        	  MD_DirtyMap *ram,
+        	  MD_DirtyMap *sram
+        	  )
+{
+  
+  ram->bits= &(_dirty_ram[0]);
+  ram->npages= 65536>>DIRTY_PAGE_BITS;
+  ram->page_bits= DIRTY_PAGE_BITS;
+  sram->bits= &(_dirty_sram[0]);
+  sram->npages= _sram.mem == NULL ? 0 :
+    (int) ((_sram.end_b-_sram.start_b+(1<<DIRTY_PAGE_BITS)-1)>>
+           DIRTY_PAGE_BITS);
+  sram->page_bits= DIRTY_PAGE_BITS;
+  
+} /* end MD_mem_get_dirty */
@@ -23,33 +23,112 @@
 
 
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef MD_ROM_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "MD.h"
 
 
 
 
+/**********/
+/* MACROS */
+/**********/
+
+/* Byte de l'adreça indicada d'una ROM preparada. */
+#define ROM_BYTE(ROM,ADDR) ((ROM)->bytes[(ADDR)^MD_BYTE_SWAP])
+
+/* Capçalera de les imatges de 'MD_rom_save'. L'ordre es guarda en
+ * l'ordre de la màquina que l'ha escrita.
+ */
+#define IMG_MAGIC "MDROMIMG"
+#define IMG_ORDER 0x01020304
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+typedef struct
+{
+  
+  char  magic[8];     /* IMG_MAGIC. */
+  MDu32 order;        /* IMG_ORDER. */
+  MDu32 nbytes;       /* Bytes de la ROM després de la capçalera. */
+  
+} img_header_t;
+
+
+
+
 /*********************/
 /* FUNCIONS PRIVADES */
 /*********************/
 
 static MDu32
 bs2u32 (
-        const MDu8 *bytes
+        const MD_Rom *rom,
+        const MDu32   addr
         )
 {
   
   return
-    (((MDu32) bytes[0])<<24) |
-    (((MDu32) bytes[1])<<16) |
-    (((MDu32) bytes[2])<<8) |
-    bytes[3];
+    (((MDu32) ROM_BYTE ( rom, addr ))<<24) |
+    (((MDu32) ROM_BYTE ( rom, addr+1 ))<<16) |
+    (((MDu32) ROM_BYTE ( rom, addr+2 ))<<8) |
+    ROM_BYTE ( rom, addr+3 );
   
 } /* end bsu32 */
 
 
+/* Copia N bytes de la ROM a partir de l'adreça indicada i afegix el
+ * caràcter nul.
+ */
+static void
+get_str (
+         char         *dst,
+         const MD_Rom *rom,
+         const MDu32   addr,
+         const int     n
+         )
+{
+  
+  int i;
+  
+  
+  for ( i= 0; i < n; ++i )
+    dst[i]= (char) ROM_BYTE ( rom, addr+i );
+  dst[n]= '\0';
+  
+} /* end get_str */
+
+
+/* Comprova la capçalera d'una imatge de SIZE bytes en total. */
+static MD_Bool
+check_img_header (
+        	  const img_header_t *h,
+        	  const long          size
+        	  )
+{
+  
+  return
+    memcmp ( h->magic, IMG_MAGIC, sizeof(h->magic) ) == 0 &&
+    h->order == IMG_ORDER &&
+    h->nbytes != 0 && (h->nbytes&0x1) == 0 && h->nbytes <= 0x7FFFFFFE &&
+    (long) h->nbytes == size - (long) sizeof(img_header_t);
+  
+} /* end check_img_header */
+
+
 
 
 /**********************/
@@ -69,7 +148,7 @@ MD_rom_check_checksum (
   val= 0;
   for ( i= 0x100; i < rom->nwords; ++i )
     val+= rom->words[i].v;
-  checksum= (((MDu16) rom->bytes[0x18E])<<8) | rom->bytes[0x18F];
+  checksum= rom->words[0x18E>>1].v;
   
   return (checksum==val);
   
@@ -82,10 +161,14 @@ MD_rom_free (
              )
 {
 
-#ifdef MD_LE
-  if ( rom->words != NULL ) free ( rom->words );
+  if ( rom->bytes == NULL ) return;
+#ifdef MD_ROM_MMAP
+  if ( rom->mapped )
+    munmap ( rom->bytes - sizeof(img_header_t),
+             rom->nbytes + sizeof(img_header_t) );
+  else
 #endif
-  if ( rom->bytes != NULL ) free ( rom->bytes );
+    free ( rom->bytes );
   
 } /* end MD_rom_free */
 
@@ -98,47 +181,40 @@ MD_rom_get_header (
 {
   
   /* The name of the console. */
-  memcpy ( header->console, &(rom->bytes[0x100]), 16 );
-  header->console[16]= '\0';
+  get_str ( header->console, rom, 0x100, 16 );
   
   /* Firm name and build date. */
-  memcpy ( header->firm_build, &(rom->bytes[0x110]), 16 );
-  header->firm_build[16]= '\0';
+  get_str ( header->firm_build, rom, 0x110, 16 );
   
   /* Domestic name. */
-  memcpy ( header->dom_name, &(rom->bytes[0x120]), 48 );
-  header->dom_name[48]= '\0';
+  get_str ( header->dom_name, rom, 0x120, 48 );
   
   /* International name. */
-  memcpy ( header->int_name, &(rom->bytes[0x150]), 48 );
-  header->int_name[48]= '\0';
+  get_str ( header->int_name, rom, 0x150, 48 );
   
   /* Program type and serial number. */
-  memcpy ( header->type_snumber, &(rom->bytes[0x180]), 14 );
-  header->type_snumber[14]= '\0';
+  get_str ( header->type_snumber, rom, 0x180, 14 );
   
   /* Checksum. */
-  header->checksum= (((MDu16) rom->bytes[0x18E])<<8) | rom->bytes[0x18F];
+  header->checksum= rom->words[0x18E>>1].v;
   
   /* I/O device support. */
-  memcpy ( header->io, &(rom->bytes[0x190]), 16 );
-  header->io[16]= '\0';
+  get_str ( header->io, rom, 0x190, 16 );
   
   /* Start of the ROM. */
-  header->start= bs2u32 ( &(rom->bytes[0x1A0]) );
+  header->start= bs2u32 ( rom, 0x1A0 );
   
   /* End of the ROM. */
-  header->end= bs2u32 ( &(rom->bytes[0x1A4]) );
+  header->end= bs2u32 ( rom, 0x1A4 );
   
   /* Start of RAM. */
-  header->start_ram= bs2u32 ( &(rom->bytes[0x1A8]) );
+  header->start_ram= bs2u32 ( rom, 0x1A8 );
   
   /* End of RAM. */
-  header->end_ram= bs2u32 ( &(rom->bytes[0x1AC]) );
+  header->end_ram= bs2u32 ( rom, 0x1AC );
   
   /* Backup RAM ID. */
-  memcpy ( header->sramid, &(rom->bytes[0x1B0]), 4 );
-  header->sramid[4]= '\0';
+  get_str ( header->sramid, rom, 0x1B0, 4 );
   header->sram_flags= 0;
   if ( header->sramid[0]=='R' && header->sramid[1]=='A' &&
        (header->sramid[2]&0xA7)==0xA0 && header->sramid[3]==0x20 )
@@ -163,52 +239,158 @@ MD_rom_get_header (
   /* Start address of backup RAM. */
   header->start_sram= 
     (header->sram_flags&MD_SRAMINFO_AVAILABLE) ?
-    bs2u32 ( &(rom->bytes[0x1B4]) ) : 0;
+    bs2u32 ( rom, 0x1B4 ) : 0;
   
   /* End address of backup RAM. */
   header->end_sram= 
     (header->sram_flags&MD_SRAMINFO_AVAILABLE) ?
-    bs2u32 ( &(rom->bytes[0x1B8]) ) : 0;
+    bs2u32 ( rom, 0x1B8 ) : 0;
   
   /* Modem support. */
-  memcpy ( header->modem, &(rom->bytes[0x1BC]), 12 );
-  header->modem[12]= '\0';
+  get_str ( header->modem, rom, 0x1BC, 12 );
   
   /* Notes. */
-  memcpy ( header->notes, &(rom->bytes[0x1C8]), 40 );
-  header->notes[40]= '\0';
+  get_str ( header->notes, rom, 0x1C8, 40 );
   
   /* Country codes. */
-  memcpy ( header->ccodes, &(rom->bytes[0x1F0]), 16 );
-  header->ccodes[16]= '\0';
+  get_str ( header->ccodes, rom, 0x1F0, 16 );
   
 } /* end MD_rom_get_header */
 
 
+MD_Error
+MD_rom_map (
+            MD_Rom     *rom,
+            const char *fname
+            )
+{
+  
+#ifdef MD_ROM_MMAP
+  int fd;
+  struct stat st;
+  void *p;
+  
+  
+  fd= open ( fname, O_RDONLY );
+  if ( fd == -1 ) return MD_EFILE;
+  if ( fstat ( fd, &st ) == -1 ||
+       st.st_size <= (off_t) sizeof(img_header_t) ||
+       st.st_size > 0x7FFFFFFF )
+    {
+      close ( fd );
+      return MD_EFILE;
+    }
+  p= mmap ( NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  close ( fd );
+  if ( p == MAP_FAILED ) return MD_EFILE;
+  if ( !check_img_header ( (const img_header_t *) p, (long) st.st_size ) )
+    {
+      munmap ( p, (size_t) st.st_size );
+      return MD_EFILE;
+    }
+  
+  rom->bytes= ((MDu8 *) p) + sizeof(img_header_t);
+  rom->nbytes= ((const img_header_t *) p)->nbytes;
+#else
+  FILE *f;
+  img_header_t h;
+  long size;
+  
+  
+  /* Sense mmap es llig la imatge en memòria. Es marca igualment com
+     a projectada perquè no es torne a preparar. */
+  f= fopen ( fname, "rb" );
+  if ( f == NULL ) return MD_EFILE;
+  if ( fseek ( f, 0, SEEK_END ) != 0 || (size= ftell ( f )) == -1 ||
+       fseek ( f, 0, SEEK_SET ) != 0 ||
+       fread ( &h, sizeof(h), 1, f ) != 1 ||
+       !check_img_header ( &h, size ) )
+    {
+      fclose ( f );
+      return MD_EFILE;
+    }
+  rom->bytes= (MDu8 *) malloc ( h.nbytes );
+  if ( rom->bytes == NULL )
+    {
+      fclose ( f );
+      return MD_EMEM;
+    }
+  if ( fread ( rom->bytes, 1, h.nbytes, f ) != h.nbytes )
+    {
+      free ( rom->bytes );
+      rom->bytes= NULL;
+      fclose ( f );
+      return MD_EFILE;
+    }
+  fclose ( f );
+  rom->nbytes= h.nbytes;
+#endif
+  
+  rom->nwords= (int) (rom->nbytes/2);
+  rom->words= (MD_Word *) rom->bytes;
+  rom->mapped= MD_TRUE;
+  
+  return MD_NOERROR;
+  
+} /* end MD_rom_map */
+
+
 MD_Error
 MD_rom_prepare (
         	MD_Rom *rom
         	)
 {
   
+#ifdef MD_LE
   int i;
-  const MDu8 *b;
+  MDu8 tmp,*b;
+#endif
   
   
-  /* Paraules. */
+  /* Les imatges projectades ja estan preparades. */
+  if ( rom->mapped ) return MD_NOERROR;
+  
+  /* Paraules en l'ordre de la màquina sobre els mateixos bytes. */
 #ifdef MD_LE
-  rom->words= (MD_Word *) malloc ( sizeof(MD_Word)*rom->nwords );
-  if ( rom->words == NULL ) return MD_EMEM;
-  for ( i= 0, b= rom->bytes; i < rom->nwords; ++i )
+  for ( i= 0, b= rom->bytes; i < rom->nwords; ++i, b+= 2 )
     {
-      rom->words[i].b.v1= *(b++);
-      rom->words[i].b.v0= *(b++);
+      tmp= b[0];
+      b[0]= b[1];
+      b[1]= tmp;
     }
-#else /* MD_BE */
-  rom->words= (MD_Word *) rom->bytes;
 #endif
+  rom->words= (MD_Word *) rom->bytes;
   rom->nbytes= (MDu32) (rom->nwords*2);
+  rom->mapped= MD_FALSE;
   
   return MD_NOERROR;
   
 } /* end MD_rom_prepare */
+
+
+MD_Error
+MD_rom_save (
+             const MD_Rom *rom,
+             const char   *fname
+             )
+{
+  
+  FILE *f;
+  img_header_t h;
+  MD_Bool ok;
+  
+  
+  memset ( &h, 0, sizeof(h) );
+  memcpy ( h.magic, IMG_MAGIC, sizeof(h.magic) );
+  h.order= IMG_ORDER;
+  h.nbytes= (MDu32) (rom->nwords*2);
+  f= fopen ( fname, "wb" );
+  if ( f == NULL ) return MD_EFILE;
+  ok= fwrite ( &h, sizeof(h), 1, f ) == 1 &&
+    fwrite ( rom->words, sizeof(MD_Word), rom->nwords, f ) ==
+    (size_t) rom->nwords;
+  if ( fclose ( f ) != 0 ) ok= MD_FALSE;
+  
+  return ok ? MD_NOERROR : MD_EFILE;
+  
+} /* end MD_rom_save */
@@ -162,6 +162,16 @@ static uint16_t _iram[IRAM_SIZE];
 // RAM (fast ram)
 static uint16_t _ram[2][RAM_SIZE];
 
+// Punts de vigilància del bus extern.
+static struct
+{
+  
+  MD_Bool      enabled;
+  const MDu64 *rmap;
+  const MDu64 *wmap;
+  
+} _watch;
+
 // Registres
 static struct
 {
@@ -274,9 +284,9 @@ read (
 
 
 static uint16_t
-read_ext (
-          const uint32_t addr // Està en words!!!!
-          )
+read_ext_mem (
+              const uint32_t addr // Està en words!!!!
+              )
 {
 
   // ROM
@@ -309,14 +319,32 @@ read_ext (
   // cell arrange, unused (2), ¿¿status/control???
   else return 0x0000;
   
+} // end read_ext_mem
+
+
+static uint16_t
+read_ext (
+          const uint32_t addr // Està en words!!!!
+          )
+{
+
+  uint16_t ret;
+
+
+  ret= read_ext_mem ( addr );
+  if ( _watch.enabled && MD_WATCH_TEST ( _watch.rmap, addr ) )
+    MD_watch_check ( MD_WATCH_SVP, MD_READ, addr, 1, ret );
+  
+  return ret;
+  
 } // end read_ext
 
 
 static void
-write_ext (
-           const uint32_t addr, // Està en words!!!!
-           const uint16_t data
-           )
+write_ext_mem (
+               const uint32_t addr, // Està en words!!!!
+               const uint16_t data
+               )
 {
   
   // ROM i unused (1)
@@ -336,6 +364,20 @@ write_ext (
   // cell arrange, unused (2), ¿¿status/control???
   else return;
   
+} // end write_ext_mem
+
+
+static void
+write_ext (
+           const uint32_t addr, // Està en words!!!!
+           const uint16_t data
+           )
+{
+  
+  write_ext_mem ( addr, data );
+  if ( _watch.enabled && MD_WATCH_TEST ( _watch.wmap, addr ) )
+    MD_watch_check ( MD_WATCH_SVP, MD_WRITE, addr, 1, data );
+  
 } // end write_ext
 
 
@@ -2442,6 +2484,11 @@ MD_svp_init (
   _warning= warning;
   _cpu_step_svp= cpu_step_svp;
   _udata= udata;
+
+  // Punts de vigilància.
+  _watch.enabled= MD_FALSE;
+  _watch.rmap= MD_watch_get_map ( MD_WATCH_SVP, MD_READ );
+  _watch.wmap= MD_watch_get_map ( MD_WATCH_SVP, MD_WRITE );
   
   // Inicialitza.
   check_rom ( rom );
@@ -2711,3 +2758,12 @@ MD_svp_load_state (
   return 0;
   
 } // end MD_svp_load_state
+
+
+void
+MD_svp_set_watch (
+        	  const MD_Bool val
+        	  )
+{
+  _watch.enabled= val;
+} // end MD_svp_set_watch
@@ -87,6 +87,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "MD.h"
 
@@ -107,6 +110,27 @@
   if ( !(COND) ) return -1;
 
 #define MAX(a,b) (((a)>(b)) ? (a) : (b))
+
+/* Seguiment de pàgines modificades. La VRAM es divideix en patrons
+ * (32 bytes), la CRAM en paletes (16 colors) i la VSRAM en columnes
+ * (entrada del pla A i del pla B).
+ */
+#define VRAM_DIRTY_BITS 5
+#define CRAM_DIRTY_BITS 5
+#define VSRAM_DIRTY_BITS 2
+#define VRAM_DIRTY(ADDR)        					\
+  (MD_DIRTY_SET ( _dirty.vram, (ADDR)>>VRAM_DIRTY_BITS ),        	\
+   TILE_INVALIDATE ( (ADDR)>>VRAM_DIRTY_BITS ))
+#define CRAM_DIRTY(IND)        					\
+  (MD_DIRTY_SET ( _dirty.cram, (IND)>>(CRAM_DIRTY_BITS-1) ),        \
+   update_rgb ( IND ))
+#define VSRAM_DIRTY(IND)        					\
+  MD_DIRTY_SET ( _dirty.vsram, (IND)>>(VSRAM_DIRTY_BITS-1) )
+
+/* Invalida un patró (unitat de 32 bytes) de la cache de patrons. */
+#define TILE_INVALIDATE(UNIT)        					\
+  (_tiles.valid[(UNIT)>>6]&= ~(((MDu64) 1)<<((UNIT)&0x3F)))
+
 #define MIN(a,b) (((a)<(b)) ? (a) : (b))
 
 #define _64K 65536
@@ -193,46 +217,12 @@
   if ( NT&0x1000 /*vf*/ ) addr_pat|= (maxrowcell-(row&maxrowcell))<<2;        \
   else                    addr_pat|= (row&maxrowcell)<<2
 
-#define INIT_BITS_AND_VALS        			\
-  byte0= _vram[addr_pat++]; byte1= _vram[addr_pat++];        \
-  byte2= _vram[addr_pat++]; byte3= _vram[addr_pat];        \
-  if ( NT&0x0800 /*hf*/)        			\
-    bits=        					\
-      (((MDu64) (((byte0&0xF)<<4)|(byte0>>4)))<<32) |        \
-      (((MDu64) (((byte1&0xF)<<4)|(byte1>>4)))<<40) |        \
-      (((MDu64) (((byte2&0xF)<<4)|(byte2>>4)))<<48) |        \
-      (((MDu64) (((byte3&0xF)<<4)|(byte3>>4)))<<56);        \
-  else        						\
-    bits=        					\
-      (((MDu64) byte3)<<32) |        			\
-      (((MDu64) byte2)<<40) |        			\
-      (((MDu64) byte1)<<48) |        			\
-      (((MDu64) byte0)<<56);        			\
-  pal_vals[0]= (MDu8) (((NT>>13)&0x3)<<4);        	\
-  prior_vals[0]= (MDu8) (NT>>15)
-
-#define LOAD_BITS_AND_VALS        			\
-  byte0= _vram[addr_pat++]; byte1= _vram[addr_pat++];        \
-  byte2= _vram[addr_pat++]; byte3= _vram[addr_pat];        \
-  if ( NT&0x0800 /*hf*/)        			\
-    bits|=        					\
-      ((MDu64) (((byte0&0xF)<<4)|(byte0>>4))) |        	\
-      (((MDu64) (((byte1&0xF)<<4)|(byte1>>4)))<<8) |        \
-      (((MDu64) (((byte2&0xF)<<4)|(byte2>>4)))<<16) |        \
-      (((MDu64) (((byte3&0xF)<<4)|(byte3>>4)))<<24);        \
-  else        						\
-    bits|=        					\
-      ((MDu64) byte3) |        				\
-      (((MDu64) byte2)<<8) |        			\
-      (((MDu64) byte1)<<16) |        			\
-      (((MDu64) byte0)<<24);        			\
-  pal_vals[1]= (MDu8) (((NT>>13)&0x3)<<4);        	\
-  prior_vals[1]= (MDu8) (NT>>15)
-
 #define NSPRITES 80
 
-#define SHA_COLOR -1
-#define HIG_COLOR -2
+/* Colors especials dels sprites en mode S/TE. Els colors normals són
+ * menors que SHA_COLOR i 0 és transparent. */
+#define SHA_COLOR 0x40
+#define HIG_COLOR 0x80
 
 
 
@@ -247,11 +237,9 @@ typedef struct
   int     off;
   int     off_2;
   MDu16   NT_addr;
-  MDu8    line[MAXWIDTH];
-  MD_Bool isp0[MAXWIDTH];
-  int     prio0[MAXWIDTH]; /* prio0 i prio1 són piles de N0,N1. */
-  int     prio1[MAXWIDTH];
-  int     N0,N1;
+  MDu8    line[MAXWIDTH]; /* 0 - Transparent. */
+  MDu8    hi[MAXWIDTH];   /* 1 - Prioritat alta. */
+  MDu8    isp0[MAXWIDTH]; /* Per al S/TE. */
   
 } scroll_t;
 
@@ -296,14 +284,66 @@ typedef struct
 } sprite_buff_t;
 
 
+/* Valors del buffer S/TE. */
+enum {
+  NOR= 0,
+  SHA,
+  HIG
+};
+
+
+/* Disposició de l'estat renderitzat en els fitxers d'estat. És la
+ * que tenia _render abans de les caches de patrons, i es conserva
+ * per a poder carregar els estats desats amb versions anteriors.
+ */
+typedef struct
+{
+  
+  int     off;
+  int     off_2;
+  MDu16   NT_addr;
+  MDu8    line[MAXWIDTH];
+  MD_Bool isp0[MAXWIDTH];
+  int     prio0[MAXWIDTH]; /* prio0 i prio1 són piles de N0,N1. */
+  int     prio1[MAXWIDTH];
+  int     N0,N1;
+  
+} scroll_state_t;
+
+
 typedef struct
 {
   
-  int color;
+  int color; // -1 - SHA, -2 - HIG
   int type; // -1 - None, 0 - LowPrio, 1 - HighPrio
   int coll_counter;
   
-} sprite_pixel_t;
+} sprite_pixel_state_t;
+
+
+typedef struct
+{
+  
+  int                  fb[MAXWIDTH*MAXHEIGHT];
+  int                 *p;  /* Desplaçament respecte a fb. */
+  MDu8                 bgcolor;
+  int                  width;
+  int                  tmp[MAXWIDTH];
+  sprite_pixel_state_t spr_line[MAXWIDTH];
+  int                  s_te[MAXWIDTH]; /* NOR, SHA o HIG desplaçat 9 bits. */
+  MDu16                lines;
+  scroll_state_t       sc[2];
+  MDu16                Htable;
+  MDu8                 HSZ,VSZ;
+  int                  hsc_mode;
+  MD_Bool              vsc_mode_is_cell;
+  MDu16                win_NT_addr;
+  MD_Bool              isRIGT,isDOWN;
+  MDu8                 WHP,WVP;
+  MD_Bool              dot_overflow;
+  MD_Bool              S_TE;
+  
+} render_state_t;
 
 
 
@@ -333,6 +373,31 @@ static MDu8 _vram[_64K];
 static MDu16 _cram[64]; /* 9 bit words!. B*3G*3R*3 */
 static MDu16 _vsram[40]; /* 10 bit words!. */
 
+/* Pàgines modificades de la memòria. */
+static struct
+{
+  
+  MDu64 vram[(_64K>>VRAM_DIRTY_BITS)/64];
+  MDu64 cram[1];
+  MDu64 vsram[1];
+  
+} _dirty;
+
+/* Cache de patrons descodificats (un byte per píxel). Cada unitat
+ * de 32 bytes de la VRAM té les 8 files normals i invertides (hflip)
+ * i la màscara de píxels no transparents. En interlace mode 3 un
+ * patró ocupa dos unitats. Les escriptures en la VRAM invaliden la
+ * unitat amb VRAM_DIRTY.
+ */
+static struct
+{
+  
+  MDu8  pix[_64K>>VRAM_DIRTY_BITS][8][2][8];
+  MDu8  mask[_64K>>VRAM_DIRTY_BITS][8][2];
+  MDu64 valid[(_64K>>VRAM_DIRTY_BITS)/64];
+  
+} _tiles;
+
 /* Registres. */
 static struct
 {
@@ -498,13 +563,11 @@ static struct
   MDu8 bgcolor;                   /* Color de background. */
   int  width;                     /* Amplaria de la línia en píxels
         			     reals. */
-  int      tmp[MAXWIDTH];
-  sprite_pixel_t spr_line[MAXWIDTH];
-  enum {
-    NOR= 0x000,
-    SHA= 0x200,
-    HIG= 0x400
-  }        s_te[MAXWIDTH];
+  MDu8     tmp[MAXWIDTH];
+  MDu8     spr_color[MAXWIDTH]; /* 0 - Transparent. */
+  MDu8     spr_hi[MAXWIDTH];    /* 1 - Prioritat alta. */
+  MDu8     spr_coll[MAXWIDTH];  /* Sprites opacs en el píxel. */
+  MDu8     s_te[MAXWIDTH];      /* NOR, SHA o HIG. */
   MDu16    lines;                      /* linies que porte. */
   scroll_t sc[2];   /* 0->A, 1->B */
   MDu16    Htable;
@@ -526,6 +589,33 @@ static sprite_buff_t _sprites_buff;
 /* Interrupció Z80. Indica que encara no s'ha de desactivar. */
 static MD_Bool _z80_int_enabled;
 
+// Bot de frames. Com el DMA lag, és configuració del frontend i no
+// es desa en l'estat. 'skip' decideix al principi de cada frame si es
+// dibuixa, i en eixe cas sols es fa allò que els jocs poden observar
+// (avaluació de sprites i col·lisions).
+static struct
+{
+  
+  int     n;        // Frames a botar entre frames dibuixats (<0 tots).
+  int     counter;
+  MD_Bool request;  // Dibuixa el següent frame.
+  MD_Bool skip;     // El frame actual no es dibuixa.
+  
+} _fskip= { 0, 0, MD_FALSE, MD_FALSE };
+
+// Eixida directa en RGB. És configuració del frontend i no es desa
+// en l'estat. 'pal' té els colors de la CRAM ja convertits al format
+// d'eixida, per a NOR, SHA i HIG, i s'actualitza al escriure la CRAM.
+static struct
+{
+  
+  MD_RGBFormat  format;
+  void         *buf;
+  int           pitch;   // En bytes.
+  MDu32         pal[3][64];
+  
+} _rgb;
+
 // DMA lag. No cal desar-ho en l'estat!!!!! Quan es carrega la ROM es
 // configura, és una constant que depen de la ROM.
 static int _dma_lag= 0;
@@ -551,6 +641,46 @@ res_changed (
 } /* end res_changed */
 
 
+/* Actualitza l'entrada IND de la paleta RGB. */
+static void
+update_rgb (
+            const int ind
+            )
+{
+  
+  MD_RGB rgb;
+  int ste;
+  
+  
+  if ( _rgb.format == MD_RGB_NONE ) return;
+  for ( ste= NOR; ste <= HIG; ++ste )
+    {
+      rgb= MD_color2rgb ( _cram[ind] | (ste<<9) );
+      if ( _rgb.format == MD_RGB_XRGB8888 )
+        _rgb.pal[ste][ind]=
+          (((MDu32) rgb.r)<<16) | (((MDu32) rgb.g)<<8) | ((MDu32) rgb.b);
+      else
+        _rgb.pal[ste][ind]=
+          (((MDu32) (rgb.r>>3))<<11) | (((MDu32) (rgb.g>>2))<<5) |
+          ((MDu32) (rgb.b>>3));
+    }
+  
+} /* end update_rgb */
+
+
+static void
+update_rgb_all (void)
+{
+  
+  int i;
+  
+  
+  for ( i= 0; i < 64; ++i )
+    update_rgb ( i );
+  
+} /* end update_rgb_all */
+
+
 static void
 update_HVC (void)
 {
@@ -948,6 +1078,7 @@ data_write (
           _vram[_access.addr]= data.b.v1;
           _vram[_access.addr|0x0001]= data.b.v0;
         }
+      VRAM_DIRTY ( _access.addr );
       break;
       
     case 0x03: /* CRAM write. */
@@ -956,11 +1087,13 @@ data_write (
         ((data.v>>3)&0x01C0) | /* B2 B1 B0 */
         ((data.v>>2)&0x0038) | /* G2 G1 G0 */
         ((data.v>>1)&0x0007);  /* R2 R1 R0 */
+      CRAM_DIRTY ( aux );
       break;
       
     case 0x05: /* VSRAM write. */
       aux= (_access.addr%80)>>1;
       _vsram[aux]= data.v&0x07FF; /* VS10 ~ VS0 */
+      VSRAM_DIRTY ( aux );
       break;
 
     default: _warning ( _udata,
@@ -990,6 +1123,7 @@ data_write8 (
     case 0x01: /* VRAM write. */
       if ( _access.addr&0x1 ) _vram[_access.addr&0xFFFE]= data;
       else                    _vram[_access.addr|0x0001]= data;
+      VRAM_DIRTY ( _access.addr );
       break;
       
     case 0x03: /* CRAM write. */
@@ -1006,6 +1140,7 @@ data_write8 (
             ((data>>2)&0x38) | /* G2 G1 G0 */
             ((data>>1)&0x07);  /* R2 R1 R0 */
         }
+      CRAM_DIRTY ( aux );
       break;
       
     case 0x05: /* VSRAM write. */
@@ -1020,6 +1155,7 @@ data_write8 (
           _vsram[aux]&= 0x0700;
           _vsram[aux]|= data; /* VS7 ~ VS0 */
         }
+      VSRAM_DIRTY ( aux );
       break;
 
     default: _warning ( _udata,
@@ -1054,12 +1190,14 @@ dma_fill (
     {
       _vram[_access.addr]= _dma.fill_data.b.v0;
       _vram[_access.addr^0x1]= _dma.fill_data.b.v1;
+      VRAM_DIRTY ( _access.addr );
       _access.addr+= _regs.auto_increment_data;
       _dma.fill_started= MD_TRUE;
     }
   for ( n= 0; n < nbytes; ++n )
     {
       _vram[_access.addr^0x1]= _dma.fill_data.b.v1;
+      VRAM_DIRTY ( _access.addr );
       _access.addr+= _regs.auto_increment_data;
       if ( --_regs.dma_length_counter_tmp == 0 ) return 1;
     }
@@ -1082,6 +1220,7 @@ dma_copy (
   for ( n= 0; n < nbytes; ++n )
     {
       _vram[_access.addr]= _vram[_regs.dma_source_address_tmp&0xFFFF];
+      VRAM_DIRTY ( _access.addr );
       ++_regs.dma_source_address_tmp;
       _access.addr+= _regs.auto_increment_data;
       if ( --_regs.dma_length_counter_tmp == 0 ) return 1;
@@ -1224,7 +1363,7 @@ render_spr_line_set_val (
         		 )
 {
 
-  int new_color;
+  MDu8 new_color;
   
 
   // Calcula el color.
@@ -1247,35 +1386,160 @@ render_spr_line_set_val (
   else return; // Transparent
 
   // Inserta color
-  if ( _render.spr_line[x].type == -1 )
-    _render.spr_line[x].coll_counter= 0;
-  _render.spr_line[x].color= new_color;
-  _render.spr_line[x].type= isp0 ? 0 : 1;
-  if ( new_color != SHA_COLOR && new_color != HIG_COLOR )
+  _render.spr_color[x]= new_color;
+  _render.spr_hi[x]= isp0 ? 0 : 1;
+  if ( new_color < SHA_COLOR )
     {
-      if ( ++_render.spr_line[x].coll_counter > 1 )
+      if ( ++_render.spr_coll[x] > 1 )
         _status_aux.spr_collision= MD_TRUE;
     }
   
 } // end render_spr_line_set_val
 
 
+/* Descodifica una fila (8 píxels) d'un patró de 4bpp. Escriu en out
+ * els colors (0-15) en ordre de pantalla, invertits si hflip, i torna
+ * una màscara amb un bit per píxel no transparent (bit 0 -> out[0]).
+ */
+static int
+decode_tile_row (
+        	 const MDu16    addr_pat,
+        	 const MD_Bool  hflip,
+        	 MDu8          *out
+        	 )
+{
+  
+  MDu32 v;
+#ifdef __SSE2__
+  __m128i aux, pix;
+#else
+  MDu64 t, nz;
+  int i;
+#endif
+  
+  
+  /* Byte k de v -> píxels 2k (nibble alt) i 2k+1 (nibble baix). En
+     hflip s'inverteix l'ordre dels bytes i dels nibbles. */
+  v=
+    ((MDu32) _vram[addr_pat]) |
+    (((MDu32) _vram[addr_pat|1])<<8) |
+    (((MDu32) _vram[addr_pat|2])<<16) |
+    (((MDu32) _vram[addr_pat|3])<<24);
+  if ( hflip )
+    {
+      v= (v>>24) | ((v>>8)&0x0000FF00) | ((v<<8)&0x00FF0000) | (v<<24);
+      v= ((v&0x0F0F0F0F)<<4) | ((v>>4)&0x0F0F0F0F);
+    }
+  
+#ifdef __SSE2__
+  aux= _mm_cvtsi32_si128 ( (int) v );
+  pix= _mm_unpacklo_epi8 ( _mm_and_si128 ( _mm_srli_epi16 ( aux, 4 ),
+        				   _mm_set1_epi8 ( 0x0F ) ),
+        		   _mm_and_si128 ( aux, _mm_set1_epi8 ( 0x0F ) ) );
+  _mm_storel_epi64 ( (__m128i *) out, pix );
+  
+  return (~_mm_movemask_epi8 ( _mm_cmpeq_epi8 ( pix,
+        					_mm_setzero_si128 () ) ))&0xFF;
+#else
+  /* Cada byte de v passa a ocupar 16 bits i després es separen els
+     nibbles en bytes. */
+  t= (MDu64) v;
+  t= (t|(t<<16))&0x0000FFFF0000FFFFULL;
+  t= (t|(t<<8))&0x00FF00FF00FF00FFULL;
+  t= ((t>>4)&0x000F000F000F000FULL) | ((t&0x000F000F000F000FULL)<<8);
+  nz= ((t+0x7F7F7F7F7F7F7F7FULL)&0x8080808080808080ULL)>>7;
+  for ( i= 0; i < 8; ++i )
+    out[i]= (MDu8) (t>>(i*8));
+  
+  return (int) ((nz*0x0102040810204080ULL)>>56);
+#endif
+  
+} /* end decode_tile_row */
+
+
+/* Torna la fila d'un patró (addr_pat apunta a la fila) des de la
+ * cache de patrons, descodificant el patró sencer si la VRAM ha
+ * canviat. En mask torna la màscara de píxels no transparents.
+ */
+static const MDu8 *
+get_tile_row (
+              const MDu16    addr_pat,
+              const MD_Bool  hflip,
+              int           *mask
+              )
+{
+  
+  int unit, row, r;
+  MDu16 addr;
+  
+  
+  unit= addr_pat>>VRAM_DIRTY_BITS;
+  if ( !(_tiles.valid[unit>>6]&(((MDu64) 1)<<(unit&0x3F))) )
+    {
+      addr= (MDu16) (unit<<VRAM_DIRTY_BITS);
+      for ( r= 0; r < 8; ++r, addr+= 4 )
+        {
+          _tiles.mask[unit][r][0]=
+            decode_tile_row ( addr, MD_FALSE, _tiles.pix[unit][r][0] );
+          _tiles.mask[unit][r][1]=
+            decode_tile_row ( addr, MD_TRUE, _tiles.pix[unit][r][1] );
+        }
+      _tiles.valid[unit>>6]|= ((MDu64) 1)<<(unit&0x3F);
+    }
+  row= (addr_pat>>2)&0x7;
+  *mask= _tiles.mask[unit][row][hflip];
+  
+  return &(_tiles.pix[unit][row][hflip][0]);
+  
+} /* end get_tile_row */
+
+
+/* Copia en out la fila d'un patró d'un pla amb la paleta i el hflip
+ * del NT.
+ */
+static void
+copy_tile_row (
+               const MDu16  NT,
+               const MDu16  addr_pat,
+               MDu8        *out
+               )
+{
+  
+  const MDu8 *pix;
+  MDu64 t, nz, pal;
+  int mask;
+  
+  
+  pix= get_tile_row ( addr_pat, (NT&0x0800)!=0 /*hf*/, &mask );
+  memcpy ( &t, pix, 8 );
+  pal= (MDu64) (((NT>>13)&0x3)<<4);
+  if ( pal )
+    {
+      /* Les operacions són byte a byte, no depenen de l'endianisme. */
+      nz= ((t+0x7F7F7F7F7F7F7F7FULL)&0x8080808080808080ULL)>>7;
+      t|= (nz*0xFF)&(pal*0x0101010101010101ULL);
+    }
+  memcpy ( out, &t, 8 );
+  
+} /* end copy_tile_row */
+
+
 static void
 render_line_spr (
         	 sprite_buff_t const * const buffer
         	 )
 {
   
-  int n, row, pat_height, pat_size, w, i, x, begin, end, width;
+  int n, row, pat_height, pat_size, w, i, x, begin, end, width, m;
   const sprite_t *p;
-  MDu16 addr_pat, addr, inc_pat;
-  MDu8 byte, color;
+  const MDu8 *pix;
+  MDu16 addr_pat, inc_pat;
   MD_Bool isp0;
   
   
   /* Preliminars. */
-  for ( i= 0; i < _csize.width; ++i )
-    _render.spr_line[i].type= -1;
+  memset ( _render.spr_color, 0, _csize.width );
+  memset ( _render.spr_coll, 0, _csize.width );
   if ( _regs.interlace_mode == 3 )
     {
       pat_height= 16;
@@ -1309,27 +1573,14 @@ render_line_spr (
           
           addr_pat= (p->pat*pat_size); /* Adreçá pat 0. */
           addr_pat+= (row/pat_height)*pat_size; /* Adreça pat on està row. */
-          addr_pat+= (row%pat_height)*4; /* Adreça inicial si no fora flip. */
-          addr_pat+= inc_pat*(p->width-1) + 3; /* Adreça inicial. */
+          addr_pat+= (row%pat_height)*4; /* Adreça de la fila. */
+          addr_pat+= inc_pat*(p->width-1); /* Últim patró. */
           for ( w= 0, x= begin; w < p->width && x < end; ++w )
             {
-              addr= addr_pat;
-              for ( i= 0; i < 4 && x < end; ++i, --addr )
-        	{
-        	  byte= _vram[addr];
-                  if ( x >= 0 )
-                    {
-                      color= byte&0xF;
-        	      render_spr_line_set_val ( color, p->pal, x, isp0 );
-                    }
-                  if ( ++x == end ) break;
-                  if ( x >= 0 )
-                    {
-                      color= byte>>4;
-        	      render_spr_line_set_val ( color, p->pal, x, isp0 );
-                    }
-                  ++x;
-        	}
+              pix= get_tile_row ( addr_pat, MD_TRUE, &m );
+              for ( i= 0; i < 8 && x < end; ++i, ++x )
+                if ( x >= 0 && (m&(1<<i)) )
+                  render_spr_line_set_val ( pix[i], p->pal, x, isp0 );
               addr_pat-= inc_pat;
             }
         }
@@ -1340,23 +1591,10 @@ render_line_spr (
           addr_pat+= (row%pat_height)*4; /* Adreça inicial. */
           for ( w= 0, x= begin; w < p->width && x < end; ++w )
             {
-              addr= addr_pat;
-              for ( i= 0; i < 4 && x < end; ++i, ++addr )
-        	{
-        	  byte= _vram[addr];
-        	  if ( x >= 0 )
-        	    {
-        	      color= byte>>4;
-        	      render_spr_line_set_val ( color, p->pal, x, isp0 );
-        	    }
-        	  if ( ++x == end ) break;
-        	  if ( x >= 0 )
-        	    {
-        	      color= byte&0xF;
-        	      render_spr_line_set_val ( color, p->pal, x, isp0 );
-        	    }
-        	  ++x;
-        	}
+              pix= get_tile_row ( addr_pat, MD_FALSE, &m );
+              for ( i= 0; i < 8 && x < end; ++i, ++x )
+                if ( x >= 0 && (m&(1<<i)) )
+                  render_spr_line_set_val ( pix[i], p->pal, x, isp0 );
               addr_pat+= inc_pat;
             }
         }
@@ -1373,11 +1611,10 @@ render_line_sc (
 {
   
   MDu16 aux, addr_row, row, init_col, col_mask, addr_col, addr, NT,
-    addr_pat, pat_size, sel_tile, row_mask, maxrowcell, rowbits;
-  MDu64 bits;
-  MDu8 byte0,byte1,byte2,byte3, pal_vals[2], prior_vals[2], color, selected;
-  int desp_bits, desp_tile, x, i, j, niters, n, ntiles, addr_row_desp, cols;
-  MD_Bool isp1;
+    addr_pat, pat_size, row_mask, maxrowcell, rowbits;
+  MDu8 buf[(MAXWIDTH/8+1)*8];
+  MDu8 hi[MAXWIDTH/8+1];
+  int fine, x, i, niters, n, ntiles, addr_row_desp, cols;
   
   
   /* Preparació. */
@@ -1408,7 +1645,6 @@ render_line_sc (
       maxrowcell= 0x7;
       rowbits= 3;
     }
-  sc->N0= sc->N1= 0;
   if ( _render.vsc_mode_is_cell )
     {
       niters= _csize.ntiles/2;
@@ -1448,39 +1684,27 @@ render_line_sc (
       aux= ((((MDu16) _vram[aux])<<8)|_vram[aux|1])&0x03FF;
       init_col= (16*n+cols-(aux%cols))%cols;
       addr_col= ((init_col>>3)<<1);
+      fine= init_col&0x7;
       
-      /* Desplaçaments. */
-      desp_bits= 60-((init_col&0x7)*4);
-      desp_tile= 15-(init_col&0x7);
-      
-      /* Renderitza. Inicialització. */
-      GET_NEXT_NT;
-      CALC_ADDR_PAT;
-      INIT_BITS_AND_VALS;
-      /* Renderitza. Cos. */
-      for ( i= 0; i < ntiles; ++i )
+      /* Descodifica els ntiles+1 patrons que toca la línia. */
+      for ( i= 0; i <= ntiles; ++i )
         {
           GET_NEXT_NT;
           CALC_ADDR_PAT;
-          LOAD_BITS_AND_VALS;
-          sel_tile= 0x00FF;
-          for ( j= 0; j < 8; ++j, ++x )
-            {
-              selected= (sel_tile>>desp_tile)&0x1;
-              isp1=  (prior_vals[selected]!=0);
-              color= (bits>>desp_bits)&0xF;
-              if ( color )
-        	{
-        	  sc->line[x]= color|pal_vals[selected];
-        	  if ( isp1 ) sc->prio1[sc->N1++]= x;
-        	  else        sc->prio0[sc->N0++]= x;
-        	}
-              else sc->line[x]= 0;
-              sc->isp0[x]= !isp1;
-              bits<<= 4; sel_tile<<= 1;
-            }
-          pal_vals[0]= pal_vals[1];
-          prior_vals[0]= prior_vals[1];
+          copy_tile_row ( NT, addr_pat, &(buf[i*8]) );
+          hi[i]= (MDu8) (NT>>15);
+        }
+      
+      /* Copia desplaçant 'fine' píxels. Cada grup de 8 píxels de
+         pantalla té els 8-fine primers del patró i i la resta del
+         patró i+1. */
+      memcpy ( &(sc->line[x]), &(buf[fine]), ntiles*8 );
+      for ( i= 0; i < ntiles; ++i, x+= 8 )
+        {
+          memset ( &(sc->hi[x]), hi[i], 8-fine );
+          memset ( &(sc->hi[x+8-fine]), hi[i+1], fine );
+          memset ( &(sc->isp0[x]), !hi[i], 8-fine );
+          memset ( &(sc->isp0[x+8-fine]), !hi[i+1], fine );
         }
       
     }
@@ -1496,11 +1720,10 @@ render_line_win (
         	 )
 {
   
-  int i, x, addr_row_desp, j, *prio, *Np;
+  int i, x, addr_row_desp;
   MDu32 addr, addr_pat, addr_nt;
   MDu16 NT, pat_size;
-  MDu8 byte, pal, color;
-  MD_Bool isp0;
+  MDu8 hi;
   
   
   pat_size= _regs.interlace_mode==3 ? 6 : 5;
@@ -1515,7 +1738,7 @@ render_line_win (
       addr_row_desp= 6;
     }
   addr= addr_nt | ((_render.lines>>3)<<addr_row_desp) | (begin<<1);
-  for ( x= begin*8, i= begin; i != end; ++i )
+  for ( x= begin*8, i= begin; i != end; ++i, x+= 8 )
     {
       
       /* Obté NT. */
@@ -1528,40 +1751,10 @@ render_line_win (
       else                    addr_pat|= (_render.lines&0x7)<<2;
       
       /* Dibuixa. */
-      pal= (MDu8) (((NT>>13)&0x3)<<4);
-      if ( (MDu8) (NT>>15) )
-        { Np= &(sc->N1); prio= &(sc->prio1[0]); isp0= MD_TRUE; }
-      else
-        { Np= &(sc->N0); prio= &(sc->prio0[0]); isp0= MD_FALSE; }
-      if ( NT&0x0800 /*hf*/)
-        {
-          addr_pat+= 4;
-          for ( j= 0; j < 4; ++j )
-            {
-              byte= _vram[--addr_pat];
-              sc->isp0[x]= isp0;
-              color= byte&0xF;
-              if ( color ) { prio[(*Np)++]= x; sc->line[x++]= color|pal; }
-              else         sc->line[x++]= 0;
-              sc->isp0[x]= isp0;
-              color= byte>>4;
-              if ( color ) { prio[(*Np)++]= x; sc->line[x++]= color|pal; }
-              else         sc->line[x++]= 0;
-            }
-        }
-      else
-        for ( j= 0; j < 4; ++j )
-          {
-            byte= _vram[addr_pat++];
-            sc->isp0[x]= isp0;
-            color= byte>>4;
-            if ( color ) { prio[(*Np)++]= x; sc->line[x++]= color|pal; }
-            else         sc->line[x++]= 0;
-            sc->isp0[x]= isp0;
-            color= byte&0xF;
-            if ( color ) { prio[(*Np)++]= x; sc->line[x++]= color|pal; }
-            else         sc->line[x++]= 0;
-          }
+      hi= (MDu8) (NT>>15);
+      copy_tile_row ( NT, (MDu16) addr_pat, &(sc->line[x]) );
+      memset ( &(sc->hi[x]), hi, 8 );
+      memset ( &(sc->isp0[x]), hi, 8 );
       
     }
   
@@ -1573,7 +1766,7 @@ render_line_scA_win (void)
 {
   
   MD_Bool all_win;
-  int aux, aux2, begin, end, n;
+  int aux, begin, end;
   scroll_t *scA;
   
   
@@ -1586,7 +1779,6 @@ render_line_scA_win (void)
   scA= &(_render.sc[0]);
   if ( all_win )
     {
-      scA->N0= scA->N1= 0;
       render_line_win ( 0, _regs.H40_cell_mode ? 40 : 32, scA );
       return;
     }
@@ -1598,94 +1790,158 @@ render_line_scA_win (void)
   /* Dibuixa. */
   render_line_sc ( scA );
   if ( begin < end )
+    render_line_win ( begin, end, scA );
+  
+} /* end render_line_scA_win */
+
+
+/* Avança a la següent línia del frame buffer. */
+static void
+next_line (void)
+{
+  
+  if ( _regs.interlace_mode == 3 )
+    {
+      _render.p+= _csize.width*2 + _render.width;
+      _render.lines+= 2;
+    }
+  else
     {
-      aux= begin*8; aux2= end*8;
-      for ( n= 0; n < scA->N0; )
-        if ( scA->prio0[n]>=aux && scA->prio0[n]<aux2 )
-          scA->prio0[n]= scA->prio0[--(scA->N0)];
-        else ++n;
-      for ( n= 0; n < scA->N1; )
-        if ( scA->prio1[n]>=aux && scA->prio1[n]<aux2 )
-          scA->prio1[n]= scA->prio1[--(scA->N1)];
-        else ++n;
-      render_line_win ( begin, end, scA );
+      _render.p+= _csize.width;
+      ++_render.lines;
     }
   
-} /* end render_line_scA_win */
+} /* end next_line */
+
+
+/* Escriu la línia actual en el buffer RGB del frontend. */
+static void
+write_line_rgb (void)
+{
+  
+  int i, y;
+  MDu32 color;
+  MDu32 *p32;
+  MDu16 *p16;
+  
+  
+  y= (int) ((_render.p - &(_render.fb[0]))/_render.width);
+  if ( _rgb.format == MD_RGB_XRGB8888 )
+    {
+      p32= (MDu32 *) (((MDu8 *) _rgb.buf) + y*_rgb.pitch);
+      if ( _regs.interlace_mode == 3 )
+        for ( i= 0; i < _csize.width; ++i )
+          {
+            color= _rgb.pal[_render.S_TE ? _render.s_te[i] : NOR]
+              [_render.tmp[i]];
+            *(p32++)= color;
+            *(p32++)= color;
+          }
+      else if ( _render.S_TE )
+        for ( i= 0; i < _csize.width; ++i )
+          p32[i]= _rgb.pal[_render.s_te[i]][_render.tmp[i]];
+      else
+        for ( i= 0; i < _csize.width; ++i )
+          p32[i]= _rgb.pal[NOR][_render.tmp[i]];
+    }
+  else
+    {
+      p16= (MDu16 *) (((MDu8 *) _rgb.buf) + y*_rgb.pitch);
+      if ( _regs.interlace_mode == 3 )
+        for ( i= 0; i < _csize.width; ++i )
+          {
+            color= _rgb.pal[_render.S_TE ? _render.s_te[i] : NOR]
+              [_render.tmp[i]];
+            *(p16++)= (MDu16) color;
+            *(p16++)= (MDu16) color;
+          }
+      else if ( _render.S_TE )
+        for ( i= 0; i < _csize.width; ++i )
+          p16[i]= (MDu16) _rgb.pal[_render.s_te[i]][_render.tmp[i]];
+      else
+        for ( i= 0; i < _csize.width; ++i )
+          p16[i]= (MDu16) _rgb.pal[NOR][_render.tmp[i]];
+    }
+  
+} /* end write_line_rgb */
 
 
 static void
 render_line (void)
 {
   
-  /* NOTA: Gaste l'algoritme del pintor. */
+  /* NOTA: Gaste l'algoritme del pintor, però aplicat píxel a píxel
+   * amb seleccions sense bots perquè el compilador puga vectoritzar
+   * el bucle. */
   /* NOTA!!! El millor document per explicar el STE és genvdp.txt. */
   
-  int n, i, color;
+  int i, color;
+  MDu8 a, b, s, c, ste, lay;
   scroll_t *scB, *scA;
   
   
+  /* Frame botat. Sols avalua els sprites, i els pinta mentre no s'haja
+     detectat ninguna col·lisió en el frame. */
+  if ( _fskip.skip )
+    {
+      if ( _regs.enabled )
+        {
+          eval_line_spr ();
+          if ( !_status_aux.spr_collision && _sprites_buff.N > 1 )
+            render_line_spr ( &_sprites_buff );
+        }
+      next_line ();
+      return;
+    }
+  
   /* Background */
-  for ( i= 0; i < _csize.width; ++i )
-    _render.tmp[i]= _render.bgcolor;
-  if ( _regs.enabled )
+  if ( !_regs.enabled )
+    memset ( _render.tmp, _render.bgcolor, _csize.width );
+  else
     {
       scB= &(_render.sc[1]); scA= &(_render.sc[0]);
       render_line_sc ( scB );
       render_line_scA_win ();/*render_line_sc ( scA );*/
       eval_line_spr ();
       render_line_spr ( &_sprites_buff );
-      /* Scroll B - Prioritat 0. */
-      for ( n= 0; n < scB->N0; ++n )
-        { i= scB->prio0[n]; _render.tmp[i]= scB->line[i]; }
-      /* Scroll A - Prioritat 0. */
-      for ( n= 0; n < scA->N0; ++n )
-        { i= scA->prio0[n]; _render.tmp[i]= scA->line[i]; }
-      /* Inicialitza buffer S_TE. */
-      if ( _render.S_TE )
-        for ( i= 0; i < _csize.width; ++i )
-          _render.s_te[i]= (scA->isp0[i] && scB->isp0[i]) ? SHA : NOR;
-      /* Sprites - Prioritat 0. */
-      for ( i= 0; i < _csize.width; ++i )
-        if ( _render.spr_line[i].type == 0 )
-          {
-            color= _render.spr_line[i].color;
-            if ( color == SHA_COLOR )
-              _render.s_te[i]= (_render.s_te[i]==HIG) ? NOR : SHA;
-            else if ( color == HIG_COLOR )
-              _render.s_te[i]= (_render.s_te[i]==SHA) ? NOR : HIG;
-            else _render.tmp[i]= color;
-          }
-      /* Scroll B - Prioritat 1. */
-      for ( n= 0; n < scB->N1; ++n )
-        { i= scB->prio1[n]; _render.tmp[i]= scB->line[i]; }
-      if ( _render.S_TE )
-        for ( n= 0; n < scB->N1; ++n )
-          { i= scB->prio1[n]; _render.s_te[i]= NOR; }
-      /* Scroll A - Prioritat 1. */
-      for ( n= 0; n < scA->N1; ++n )
-        { i= scA->prio1[n]; _render.tmp[i]= scA->line[i]; }
-      if ( _render.S_TE )
-        for ( n= 0; n < scA->N1; ++n )
-          { i= scA->prio1[n]; _render.s_te[i]= NOR; }
-      /* Sprites - Prioritat 1. */
       for ( i= 0; i < _csize.width; ++i )
-        if ( _render.spr_line[i].type == 1 )
-          {
-            color= _render.spr_line[i].color;
-            if ( color == SHA_COLOR )
-              _render.s_te[i]= (_render.s_te[i]==HIG) ? NOR : SHA;
-            else if ( color == HIG_COLOR )
-              _render.s_te[i]= (_render.s_te[i]==SHA) ? NOR : HIG;
-            else { _render.tmp[i]= color; _render.s_te[i]= NOR; }
-          }
+        {
+          b= scB->line[i]; a= scA->line[i]; s= _render.spr_color[i];
+          /* Scroll B i A - Prioritat 0. */
+          c= (b && !scB->hi[i]) ? b : _render.bgcolor;
+          c= (a && !scA->hi[i]) ? a : c;
+          ste= (scA->isp0[i] && scB->isp0[i]) ? SHA : NOR;
+          /* Sprites - Prioritat 0. */
+          lay= (s && !_render.spr_hi[i]);
+          ste= (lay && s == SHA_COLOR) ? ((ste==HIG) ? NOR : SHA) : ste;
+          ste= (lay && s == HIG_COLOR) ? ((ste==SHA) ? NOR : HIG) : ste;
+          c= (lay && s < SHA_COLOR) ? s : c;
+          /* Scroll B i A - Prioritat 1. */
+          lay= (b && scB->hi[i]);
+          c= lay ? b : c; ste= lay ? NOR : ste;
+          lay= (a && scA->hi[i]);
+          c= lay ? a : c; ste= lay ? NOR : ste;
+          /* Sprites - Prioritat 1. */
+          lay= (s && _render.spr_hi[i]);
+          ste= (lay && s == SHA_COLOR) ? ((ste==HIG) ? NOR : SHA) : ste;
+          ste= (lay && s == HIG_COLOR) ? ((ste==SHA) ? NOR : HIG) : ste;
+          c= (lay && s < SHA_COLOR) ? s : c;
+          ste= (lay && s < SHA_COLOR) ? NOR : ste;
+          _render.tmp[i]= c;
+          if ( _render.S_TE ) _render.s_te[i]= ste;
+        }
     }
-  if ( _regs.interlace_mode == 3 )
+  if ( _rgb.format != MD_RGB_NONE )
+    {
+      write_line_rgb ();
+      next_line ();
+    }
+  else if ( _regs.interlace_mode == 3 )
     {
       if ( _render.S_TE )
         for ( i= 0; i < _csize.width; ++i )
           {
-            color= _cram[_render.tmp[i]] | _render.s_te[i];
+            color= _cram[_render.tmp[i]] | (_render.s_te[i]<<9);
             *(_render.p++)= color;
             *(_render.p++)= color;
           }
@@ -1703,7 +1959,7 @@ render_line (void)
     {
       if ( _render.S_TE )
         for ( i= 0; i < _csize.width; ++i )
-          *(_render.p++)= _cram[_render.tmp[i]] | _render.s_te[i];
+          *(_render.p++)= _cram[_render.tmp[i]] | (_render.s_te[i]<<9);
       else
         for ( i= 0; i < _csize.width; ++i )
           *(_render.p++)= _cram[_render.tmp[i]];
@@ -1796,6 +2052,35 @@ render_lines (
 } /* end render_lines */
 
 
+/* Decideix si es dibuixa el següent frame que s'envia a
+ * '_update_screen'. Es crida just després d'enviar-ne un perquè el
+ * compte siga de frames de pantalla, que no sempre coincidixen amb els
+ * frames del VDP (canvis de V28/V30).
+ */
+static void
+decide_frame_skip (void)
+{
+  
+  if ( _fskip.request || _fskip.n == 0 )
+    {
+      _fskip.skip= MD_FALSE;
+      _fskip.request= MD_FALSE;
+      _fskip.counter= 0;
+    }
+  else if ( _fskip.n < 0 || _fskip.counter < _fskip.n )
+    {
+      _fskip.skip= MD_TRUE;
+      ++_fskip.counter;
+    }
+  else
+    {
+      _fskip.skip= MD_FALSE;
+      _fskip.counter= 0;
+    }
+  
+} /* end decide_frame_skip */
+
+
 static void
 run_end_frame (void)
 {
@@ -1878,7 +2163,10 @@ run (
           MD_io_end_frame_1 ();
           MD_io_end_frame_2 ();
           if ( _regs.interlace_mode != 3 || !_status_aux.odd_frame )
-            _update_screen ( _render.fb, _udata );
+            {
+              _update_screen ( _render.fb, _udata );
+              decide_frame_skip ();
+            }
           if ( _regs.V30_cell_mode_tmp != _regs.V30_cell_mode )
             set_V30_cell_mode ( _regs.V30_cell_mode_tmp );
           if ( _regs.H40_cell_mode_tmp != _regs.H40_cell_mode )
@@ -1962,14 +2250,14 @@ clock (void)
     {
       if ( _z80_int_enabled )
         {
-          Z80_IRQ ( Z80_FALSE, 0xFF );
+          MD_z80_set_int ( MD_FALSE );
           _z80_int_enabled= MD_FALSE;
         }
       _timing.cctonextline= (_timing.pointsperline - newH)*_timing.frac;
     }
   if ( _timing.cctoVInt <= 0 )
     {
-      Z80_IRQ ( Z80_TRUE, 0xFF );
+      MD_z80_set_int ( MD_TRUE );
       _z80_int_enabled= MD_TRUE;
       _status_aux.VInt= MD_TRUE;
       if ( _regs.VInt_enabled ) MD_cpu_set_auto_vector_int ( 6 );
@@ -2191,6 +2479,149 @@ set_register (
 } /* end set_register */
 
 
+/* Passa _render al format dels fitxers d'estat. ST ha d'estar a 0. */
+static void
+render2state (
+              render_state_t *st
+              )
+{
+  
+  int i, j, color;
+  const scroll_t *sc;
+  scroll_state_t *sst;
+  
+  
+  memcpy ( st->fb, _render.fb, sizeof(st->fb) );
+  st->p= (void *) (_render.p-&(_render.fb[0]));
+  st->bgcolor= _render.bgcolor;
+  st->width= _render.width;
+  for ( i= 0; i < MAXWIDTH; ++i )
+    {
+      st->tmp[i]= _render.tmp[i];
+      color= _render.spr_color[i];
+      if ( color == 0 ) st->spr_line[i].type= -1;
+      else
+        {
+          st->spr_line[i].color=
+            color == SHA_COLOR ? -1 : (color == HIG_COLOR ? -2 : color);
+          st->spr_line[i].type= _render.spr_hi[i];
+          st->spr_line[i].coll_counter= _render.spr_coll[i];
+        }
+      st->s_te[i]= _render.s_te[i]<<9;
+    }
+  st->lines= _render.lines;
+  for ( j= 0; j < 2; ++j )
+    {
+      sc= &(_render.sc[j]);
+      sst= &(st->sc[j]);
+      sst->off= sc->off;
+      sst->off_2= sc->off_2;
+      sst->NT_addr= sc->NT_addr;
+      for ( i= 0; i < MAXWIDTH; ++i )
+        {
+          sst->line[i]= sc->line[i];
+          sst->isp0[i]= sc->isp0[i] ? MD_TRUE : MD_FALSE;
+          if ( sc->line[i] == 0 ) continue;
+          if ( sc->hi[i] ) sst->prio1[sst->N1++]= i;
+          else             sst->prio0[sst->N0++]= i;
+        }
+    }
+  st->Htable= _render.Htable;
+  st->HSZ= _render.HSZ;
+  st->VSZ= _render.VSZ;
+  st->hsc_mode= _render.hsc_mode;
+  st->vsc_mode_is_cell= _render.vsc_mode_is_cell;
+  st->win_NT_addr= _render.win_NT_addr;
+  st->isRIGT= _render.isRIGT;
+  st->isDOWN= _render.isDOWN;
+  st->WHP= _render.WHP;
+  st->WVP= _render.WVP;
+  st->dot_overflow= _render.dot_overflow;
+  st->S_TE= _render.S_TE;
+  
+} /* end render2state */
+
+
+/* Recupera _render des del format dels fitxers d'estat. Sols
+ * comprova allò que fa falta per a la conversió, la resta es
+ * comprova després sobre _render.
+ */
+static int
+state2render (
+              const render_state_t *st
+              )
+{
+  
+  int i, j, n, color;
+  scroll_t *sc;
+  const scroll_state_t *sst;
+  
+  
+  memcpy ( _render.fb, st->fb, sizeof(_render.fb) );
+  _render.p= &(_render.fb[0]) + (ptrdiff_t) st->p;
+  _render.bgcolor= st->bgcolor;
+  _render.width= st->width;
+  for ( i= 0; i < MAXWIDTH; ++i )
+    {
+      CHECK ( st->tmp[i] >= 0 && st->tmp[i] <= 0x3F );
+      _render.tmp[i]= (MDu8) st->tmp[i];
+      if ( st->spr_line[i].type == -1 )
+        _render.spr_color[i]= _render.spr_hi[i]= _render.spr_coll[i]= 0;
+      else
+        {
+          CHECK ( st->spr_line[i].type == 0 || st->spr_line[i].type == 1 );
+          color= st->spr_line[i].color;
+          CHECK ( (color >= 0 && color < SHA_COLOR) ||
+                  color == -1 || color == -2 );
+          _render.spr_color[i]= (MDu8)
+            (color == -1 ? SHA_COLOR : (color == -2 ? HIG_COLOR : color));
+          _render.spr_hi[i]= (MDu8) st->spr_line[i].type;
+          CHECK ( st->spr_line[i].coll_counter >= 0 );
+          _render.spr_coll[i]= (MDu8) MIN ( st->spr_line[i].coll_counter, 2 );
+        }
+      CHECK ( (st->s_te[i]&0x600) == st->s_te[i] &&
+              st->s_te[i] != 0x600 );
+      _render.s_te[i]= (MDu8) (st->s_te[i]>>9);
+    }
+  _render.lines= st->lines;
+  for ( j= 0; j < 2; ++j )
+    {
+      sc= &(_render.sc[j]);
+      sst= &(st->sc[j]);
+      sc->off= sst->off;
+      sc->off_2= sst->off_2;
+      sc->NT_addr= sst->NT_addr;
+      for ( i= 0; i < MAXWIDTH; ++i )
+        {
+          sc->line[i]= sst->line[i];
+          sc->hi[i]= 0;
+          sc->isp0[i]= sst->isp0[i] ? 1 : 0;
+        }
+      CHECK ( sst->N1 >= 0 && sst->N1 <= MAXWIDTH );
+      for ( n= 0; n < sst->N1; ++n )
+        {
+          CHECK ( sst->prio1[n] >= 0 && sst->prio1[n] < MAXWIDTH );
+          sc->hi[sst->prio1[n]]= 1;
+        }
+    }
+  _render.Htable= st->Htable;
+  _render.HSZ= st->HSZ;
+  _render.VSZ= st->VSZ;
+  _render.hsc_mode= st->hsc_mode;
+  _render.vsc_mode_is_cell= st->vsc_mode_is_cell;
+  _render.win_NT_addr= st->win_NT_addr;
+  _render.isRIGT= st->isRIGT;
+  _render.isDOWN= st->isDOWN;
+  _render.WHP= st->WHP;
+  _render.WVP= st->WVP;
+  _render.dot_overflow= st->dot_overflow;
+  _render.S_TE= st->S_TE;
+  
+  return 0;
+  
+} /* end state2render */
+
+
 
 
 /**********************/
@@ -2214,6 +2645,56 @@ MD_vdp_clear_interrupt (
 } /* end MD_vdp_clear_interrupt */
 
 
+int
+MD_vdp_cc_to_next_event (void)
+{
+  
+  int64_t min;
+  
+  
+  if ( _status_aux.dma_busy ) return 0;
+  min= _timing.cctoVInt;
+  if ( _timing.cctoendframe < min ) min= _timing.cctoendframe;
+  if ( _regs.HInt_enabled && _timing.cctoHInt < min ) min= _timing.cctoHInt;
+  if ( _z80_int_enabled && _timing.cctonextline < min )
+    min= _timing.cctonextline;
+  min-= _timing.cc;
+  
+  return min > 0 ? (int) ((min-1)/_timing.cc2frac) : 0;
+  
+} /* end MD_vdp_cc_to_next_event */
+
+
+int
+MD_vdp_cc_to_status_change (void)
+{
+  
+  int64_t min;
+  int pos[4], i, points;
+  
+  
+  if ( _status_aux.dma_busy ) return 0;
+  
+  /* Punts de la línia on pot canviar algun bit de l'estat: HBlank,
+     VBlank (amb el HInt) i el dibuixat de la línia (sprites). */
+  pos[0]= _timing.linepp_before_end_hblank;
+  pos[1]= _timing.linepp_before_begin_hblank;
+  pos[2]= _timing.linepp_before_hint;
+  pos[3]= _timing.linepp_before_end_display;
+  points= (int) _timing.pointsperline - _timing.H;
+  for ( i= 0; i < 4; ++i )
+    if ( pos[i] > _timing.H && pos[i]-_timing.H < points )
+      points= pos[i]-_timing.H;
+  min= points*_timing.frac;
+  if ( _timing.cctoVInt < min ) min= _timing.cctoVInt;
+  if ( _timing.cctoendframe < min ) min= _timing.cctoendframe;
+  min-= _timing.cc;
+  
+  return min > 0 ? (int) ((min-1)/_timing.cc2frac) : 0;
+  
+} /* end MD_vdp_cc_to_status_change */
+
+
 MD_Bool
 MD_vdp_clock (
               const int cc
@@ -2498,6 +2979,27 @@ MD_vdp_get_cram (void)
 } /* end MD_vdp_get_cram */
 
 
+void
+MD_vdp_get_dirty (
+        	  MD_DirtyMap *vram,
+        	  MD_DirtyMap *cram,
+        	  MD_DirtyMap *vsram
+        	  )
+{
+  
+  vram->bits= &(_dirty.vram[0]);
+  vram->npages= _64K>>VRAM_DIRTY_BITS;
+  vram->page_bits= VRAM_DIRTY_BITS;
+  cram->bits= &(_dirty.cram[0]);
+  cram->npages= (64*2)>>CRAM_DIRTY_BITS;
+  cram->page_bits= CRAM_DIRTY_BITS;
+  vsram->bits= &(_dirty.vsram[0]);
+  vsram->npages= (40*2)>>VSRAM_DIRTY_BITS;
+  vsram->page_bits= VSRAM_DIRTY_BITS;
+  
+} /* end MD_vdp_get_dirty */
+
+
 const MDu8 *
 MD_vdp_get_vram (void)
 {
@@ -2567,7 +3069,10 @@ MD_vdp_init_state (void)
   /* Memòria. */
   memset ( _vram, 0, _64K );
   memset ( _cram, 0, 64*sizeof(MDu16) );
+  update_rgb_all ();
   memset ( _vsram, 0, 40*sizeof(MDu16) );
+  memset ( &_dirty, 0xFF, sizeof(_dirty) );
+  memset ( _tiles.valid, 0, sizeof(_tiles.valid) );
   
   /* Accés. */
   _access.second_pass= MD_FALSE;
@@ -2671,7 +3176,10 @@ MD_vdp_init_state (void)
   _render.isRIGT= _render.isDOWN= MD_FALSE;
   _render.WHP= _render.WVP= 0;
   _render.dot_overflow= MD_FALSE;
-  memset ( _render.spr_line, 0, sizeof(_render.spr_line) );
+  memset ( _render.spr_color, 0, sizeof(_render.spr_color) );
+  memset ( _render.spr_hi, 0, sizeof(_render.spr_hi) );
+  memset ( _render.spr_coll, 0, sizeof(_render.spr_coll) );
+  decide_frame_skip ();
   
   /* Sprites. */
   _sprites.N= 0;
@@ -2725,7 +3233,7 @@ MD_vdp_save_state (
         	   )
 {
   
-  int *aux;
+  render_state_t *st;
   size_t ret;
 
   
@@ -2739,10 +3247,11 @@ MD_vdp_save_state (
   SAVE ( _dma );
   SAVE ( _status_aux );
   SAVE ( _hint_counter );
-  aux= _render.p;
-  _render.p= (void *) (_render.p-&(_render.fb[0]));
-  ret= fwrite ( &_render, sizeof(_render), 1, f );
-  _render.p= aux;
+  st= (render_state_t *) calloc ( 1, sizeof(render_state_t) );
+  if ( st == NULL ) return -1;
+  render2state ( st );
+  ret= fwrite ( st, sizeof(render_state_t), 1, f );
+  free ( st );
   if ( ret != 1 ) return -1;
   SAVE ( _sprites );
   SAVE ( _sprites_buff );
@@ -2759,22 +3268,26 @@ MD_vdp_load_state (
         	   )
 {
 
-  int i;
+  int i, ret;
   ptrdiff_t diff;
+  render_state_t *st;
   
   
   LOAD ( _access );
+  memset ( _tiles.valid, 0, sizeof(_tiles.valid) );
   LOAD ( _vram );
   LOAD ( _cram );
   for ( i= 0; i < 64; ++i )
     {
       CHECK ( (_cram[i]&0x1FF) == _cram[i] );
     }
+  update_rgb_all ();
   LOAD ( _vsram );
   for ( i= 0; i < 40; ++i )
     {
       CHECK ( (_vsram[i]&0x7FF) == _vsram[i] );
     }
+  memset ( &_dirty, 0xFF, sizeof(_dirty) );
   LOAD ( _regs );
   CHECK ( (_regs.scrollA_name_table_addr&0xE000) ==
           _regs.scrollA_name_table_addr );
@@ -2813,34 +3326,33 @@ MD_vdp_load_state (
           DMA_FILL_BYTES_PER_LINE_H32_VBLANK );
   LOAD ( _status_aux );
   LOAD ( _hint_counter );
-  LOAD ( _render );
-  _render.p= &(_render.fb[0]) + (ptrdiff_t) _render.p;
+  st= (render_state_t *) malloc ( sizeof(render_state_t) );
+  if ( st == NULL ) return -1;
+  ret= fread ( st, sizeof(render_state_t), 1, f ) == 1 ?
+    state2render ( st ) : -1;
+  free ( st );
+  if ( ret != 0 ) return -1;
   diff= _render.p - (&(_render.fb[0]));
   CHECK ( diff <= MAXWIDTH*MAXHEIGHT && diff >= 0 );
   CHECK ( (_render.bgcolor&0x3F) == _render.bgcolor );
   CHECK ( _render.width == _csize.width*2 || _render.width == _csize.width );
   CHECK ( (&(_render.fb[0]) + _render.lines*_render.width) == _render.p );
   for ( i= 0; i < MAXWIDTH; ++i )
-    if ( _render.tmp[i] < 0 || _render.tmp[i] > 0x7FF )
+    if ( _render.tmp[i] > 0x3F )
       return -1;
   for ( i= 0; i < MAXWIDTH*MAXHEIGHT; ++i )
     if ( _render.fb[i] < 0 || _render.fb[i] > 0x7FF )
       return -1;
   for ( i= 0; i < MAXWIDTH; ++i )
-    if ( _render.s_te[i] != NOR &&
-         _render.s_te[i] != SHA &&
-         _render.s_te[i] != HIG )
+    if ( _render.s_te[i] > HIG )
       return -1;
   for ( i= 0; i < MAXWIDTH; ++i )
     {
-      if ( _render.sc[0].line[i] < 0 || _render.sc[0].line[i] > 0x7FF )
-        return -1;
-      if ( _render.sc[1].line[i] < 0 || _render.sc[1].line[i] > 0x7FF )
+      if ( _render.sc[0].line[i] > 0x3F || _render.sc[1].line[i] > 0x3F )
         return -1;
-      if ( (_render.spr_line[i].color < 0 ||
-            _render.spr_line[i].color > 0x7FF) &&
-           _render.spr_line[i].color != SHA_COLOR &&
-           _render.spr_line[i].color != HIG_COLOR )
+      if ( _render.spr_color[i] >= SHA_COLOR &&
+           _render.spr_color[i] != SHA_COLOR &&
+           _render.spr_color[i] != HIG_COLOR )
         return -1;
     }
   CHECK ( (_render.sc[0].NT_addr&0xE000) == _render.sc[0].NT_addr );
@@ -2879,3 +3391,45 @@ MD_vdp_set_dma_lag (
 {
   _dma_lag= lag;
 } // end MD_vdp_set_dma_lag
+
+
+void
+MD_vdp_set_frame_skip (
+                       const int n
+                       )
+{
+  
+  _fskip.n= n;
+  _fskip.counter= 0;
+  
+} // end MD_vdp_set_frame_skip
+
+
+MD_Bool
+MD_vdp_frame_skipped (void)
+{
+  return _fskip.skip;
+} // end MD_vdp_frame_skipped
+
+
+void
+MD_vdp_request_frame (void)
+{
+  _fskip.request= MD_TRUE;
+} // end MD_vdp_request_frame
+
+
+void
+MD_vdp_set_rgb_output (
+                       const MD_RGBFormat  format,
+                       void               *buf,
+                       const int           pitch
+                       )
+{
+  
+  _rgb.format= buf==NULL ? MD_RGB_NONE : format;
+  _rgb.buf= buf;
+  _rgb.pitch= pitch;
+  update_rgb_all ();
+  
+} // end MD_vdp_set_rgb_output
@@ -0,0 +1,301 @@
+/*
+ * Copyright 2012-2022 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/MD.
+ *
+ * adriagipas/MD is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/MD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/MD.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  watch.c - Implementació del mòdul de punts de vigilància.
+ *
+ *  Cada bus té dos mapes de bits (lectura i escriptura) amb un bit
+ *  per pàgina de 2^MD_WATCH_PAGE_BITS unitats. Els mòduls de memòria
+ *  sols comproven el bit de la pàgina i, si està actiu, criden a
+ *  'MD_watch_check', que és qui compara els rangs exactes.
+ *
+ */
+
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MD.h"
+
+
+
+
+/**********/
+/* MACROS */
+/**********/
+
+#define NBUSES 3
+
+/* Grandària en paraules de 64 bits d'un mapa de N unitats. */
+#define MAP_SIZE(N) (((N)>>MD_WATCH_PAGE_BITS)/64)
+
+#define MAP_SET(MAP,PAGE) ((MAP)[(PAGE)>>6]|= ((MDu64) 1)<<((PAGE)&0x3F))
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+typedef struct
+{
+  
+  MD_Bool     used;
+  MD_WatchBus bus;
+  MDu32       begin;
+  MDu32       end;     /* Inclosa. */
+  int         kinds;   /* MD_WATCH_READ|MD_WATCH_WRITE */
+  
+} watch_t;
+
+
+
+
+/*************/
+/* CONSTANTS */
+/*************/
+
+/* Grandària de l'espai d'adreces de cada bus (68000 en bytes, Z80 en
+ * bytes, SVP en paraules del bus extern).
+ */
+static const MDu32 BUS_SIZE[NBUSES]=
+  {
+    0x1000000,
+    0x10000,
+    0x200000
+  };
+
+
+
+
+/*********/
+/* ESTAT */
+/*********/
+
+/* Callback. */
+static MD_WatchHit *_hit;
+static void *_udata;
+
+/* Punts de vigilància. */
+static watch_t _watch[MD_WATCH_MAX];
+
+/* Número de punts actius per bus. */
+static int _nactive[NBUSES];
+
+/* Mapes de pàgines amb punts de vigilància. El primer índex és el
+ * tipus d'accés (MD_READ, MD_WRITE).
+ */
+static MDu64 _map_68k[2][MAP_SIZE(0x1000000)];
+static MDu64 _map_z80[2][MAP_SIZE(0x10000)];
+static MDu64 _map_svp[2][MAP_SIZE(0x200000)];
+
+
+
+
+/*********************/
+/* FUNCIONS PRIVADES */
+/*********************/
+
+static MDu64 *
+get_map (
+         const MD_WatchBus      bus,
+         const MD_MemAccessType type
+         )
+{
+  
+  switch ( bus )
+    {
+    case MD_WATCH_68K: return &(_map_68k[type][0]);
+    case MD_WATCH_Z80: return &(_map_z80[type][0]);
+    case MD_WATCH_SVP: return &(_map_svp[type][0]);
+    default: return NULL;
+    }
+  
+} /* end get_map */
+
+
+/* Torna a calcular els mapes d'un bus i avisa als mòduls corresponents
+ * quan el bus passa a tindre punts actius o deixa de tindre'n.
+ */
+static void
+update_bus (
+            const MD_WatchBus bus
+            )
+{
+  
+  MDu64 *rmap,*wmap;
+  MDu32 page;
+  int i,n;
+  
+  
+  rmap= get_map ( bus, MD_READ );
+  wmap= get_map ( bus, MD_WRITE );
+  memset ( rmap, 0, (BUS_SIZE[bus]>>MD_WATCH_PAGE_BITS)/8 );
+  memset ( wmap, 0, (BUS_SIZE[bus]>>MD_WATCH_PAGE_BITS)/8 );
+  n= 0;
+  for ( i= 0; i < MD_WATCH_MAX; ++i )
+    if ( _watch[i].used && _watch[i].bus == bus )
+      {
+        ++n;
+        for ( page= _watch[i].begin>>MD_WATCH_PAGE_BITS;
+              page <= _watch[i].end>>MD_WATCH_PAGE_BITS;
+              ++page )
+          {
+            if ( _watch[i].kinds&MD_WATCH_READ ) MAP_SET ( rmap, page );
+            if ( _watch[i].kinds&MD_WATCH_WRITE ) MAP_SET ( wmap, page );
+          }
+      }
+  
+  if ( (n != 0) != (_nactive[bus] != 0) )
+    switch ( bus )
+      {
+      case MD_WATCH_68K:
+        MD_mem_set_watch ( n != 0 );
+        MD_cpu_set_watch ( n != 0 );
+        break;
+      case MD_WATCH_Z80: MD_z80_set_watch ( n != 0 ); break;
+      case MD_WATCH_SVP: MD_svp_set_watch ( n != 0 ); break;
+      }
+  _nactive[bus]= n;
+  
+} /* end update_bus */
+
+
+
+
+/**********************/
+/* FUNCIONS PÚBLIQUES */
+/**********************/
+
+int
+MD_watch_add (
+              const MD_WatchBus bus,
+              const MDu32       begin,
+              const MDu32       end,
+              const int         kinds
+              )
+{
+  
+  int i;
+  
+  
+  if ( (int) bus < 0 || (int) bus >= NBUSES ||
+       begin > end || end >= BUS_SIZE[bus] ||
+       (kinds&(MD_WATCH_READ|MD_WATCH_WRITE)) == 0 )
+    return -1;
+  for ( i= 0; i < MD_WATCH_MAX && _watch[i].used; ++i );
+  if ( i == MD_WATCH_MAX ) return -1;
+  _watch[i].used= MD_TRUE;
+  _watch[i].bus= bus;
+  _watch[i].begin= begin;
+  _watch[i].end= end;
+  _watch[i].kinds= kinds;
+  update_bus ( bus );
+  
+  return i;
+  
+} /* end MD_watch_add */
+
+
+void
+MD_watch_check (
+        	const MD_WatchBus       bus,
+        	const MD_MemAccessType  type,
+        	const MDu32             addr,
+        	const int               size,
+        	const MDu16             data
+        	)
+{
+  
+  int i,kind;
+  
+  
+  if ( _hit == NULL ) return;
+  kind= type==MD_READ ? MD_WATCH_READ : MD_WATCH_WRITE;
+  for ( i= 0; i < MD_WATCH_MAX; ++i )
+    if ( _watch[i].used && _watch[i].bus == bus &&
+         (_watch[i].kinds&kind) &&
+         addr <= _watch[i].end && addr+size-1 >= _watch[i].begin )
+      _hit ( i, bus, type, addr, data, _udata );
+  
+} /* end MD_watch_check */
+
+
+void
+MD_watch_clear (void)
+{
+  
+  int bus;
+  
+  
+  memset ( _watch, 0, sizeof(_watch) );
+  for ( bus= 0; bus < NBUSES; ++bus )
+    update_bus ( (MD_WatchBus) bus );
+  
+} /* end MD_watch_clear */
+
+
+const MDu64 *
+MD_watch_get_map (
+        	  const MD_WatchBus      bus,
+        	  const MD_MemAccessType type
+        	  )
+{
+  return get_map ( bus, type );
+} /* end MD_watch_get_map */
+
+
+void
+MD_watch_init (
+               MD_WatchHit *hit,
+               void        *udata
+               )
+{
+  
+  int bus;
+  
+  
+  _hit= hit;
+  _udata= udata;
+  memset ( _watch, 0, sizeof(_watch) );
+  for ( bus= 0; bus < NBUSES; ++bus )
+    {
+      _nactive[bus]= 0;
+      update_bus ( (MD_WatchBus) bus );
+    }
+  MD_mem_set_watch ( MD_FALSE );
+  MD_cpu_set_watch ( MD_FALSE );
+  MD_z80_set_watch ( MD_FALSE );
+  MD_svp_set_watch ( MD_FALSE );
+  
+} /* end MD_watch_init */
+
+
+void
+MD_watch_remove (
+        	 const int id
+        	 )
+{
+  
+  if ( id < 0 || id >= MD_WATCH_MAX || !_watch[id].used ) return;
+  _watch[id].used= MD_FALSE;
+  update_bus ( _watch[id].bus );
+  
+} /* end MD_watch_remove */
@@ -51,6 +51,29 @@
 #define CHECK(COND)                             \
   if ( !(COND) ) return -1;
 
+/* Pàgines de 256 bytes per al seguiment de modificacions de la RAM. */
+#define DIRTY_PAGE_BITS 8
+
+/* Iteracions fallides d'un bucle abans de deixar de comprovar-lo. */
+#define IDLE_MAX_FAILS 8
+
+/* Iteracions netes que cal executar abans de mesurar-ne una. Amb les
+ * instruccions admeses l'estat dels registres és fix després de dos.
+ */
+#define IDLE_CHECK_ITERS 2
+
+/* Registres que es segueixen en la detecció de bucles d'espera. */
+#define IDLE_B   0x001
+#define IDLE_C   0x002
+#define IDLE_D   0x004
+#define IDLE_E   0x008
+#define IDLE_H   0x010
+#define IDLE_L   0x020
+#define IDLE_IXH 0x040
+#define IDLE_IXL 0x080
+#define IDLE_IYH 0x100
+#define IDLE_IYL 0x200
+
 
 
 
@@ -60,6 +83,9 @@
 
 static Z80u8 _ram[8192]; /* 8K */
 
+/* Pàgines modificades de la RAM. */
+static MDu64 _dirty[1];
+
 /* Per a llegir de la memòria del 68K. */
 static struct
 {
@@ -70,6 +96,11 @@ static struct
   
 } _bank_select;
 
+/* Punter per a llegir directament la finestra del banc
+ * (MD_mem_get_bank_window). NULL si s'ha de passar pel bus del 68K.
+ */
+static const MDu8 *_bank_mem;
+
 /* Per al timing. */
 static int _cc;
 
@@ -91,6 +122,52 @@ static struct
 static Z80u8 (*_mem_read) (Z80u16 addr);
 static void (*_mem_write) (Z80u16 addr,Z80u8 data);
 
+/* Punts de vigilància. */
+static struct
+{
+  
+  MD_Bool      enabled;
+  const MDu64 *rmap;
+  const MDu64 *wmap;
+  
+} _watch;
+
+/* Detecció de bucles d'espera. Un bucle està en espera quan una
+ * iteració sencera no té efectes laterals (sols llig la RAM, l'estat
+ * del FM o la finestra del banc) i sols executa instruccions que,
+ * repetides, deixen els registres en el mateix estat: càrregues
+ * d'immediats o de memòria, AND, OR, CP, BIT i salts, sense que cap
+ * registre carregat de memòria s'use com a adreça. El registre R no
+ * es té en compte.
+ */
+static struct
+{
+  
+  MD_Bool  enabled;
+  enum {
+    IDLE_NONE,     /* Cap bucle candidat. */
+    IDLE_CAND,     /* S'estan comprovant iteracions. */
+    IDLE_ANCHOR,   /* S'està mesurant una iteració. */
+    IDLE_LOOP      /* Bucle en espera. */
+  }        mode;
+  MD_Bool  first;        /* La següent lectura és la de l'operació. */
+  Z80u16   pc;           /* Adreça de la instrucció actual. */
+  Z80u16   last_pc;      /* Adreça de la instrucció anterior. */
+  Z80u16   head;         /* Inici del bucle candidat. */
+  int      fails;        /* Iteracions fallides. */
+  int      clean;        /* Iteracions seguides sense efectes. */
+  MD_Bool  check;        /* Cal comprovar la següent instrucció. */
+  int      wmem;         /* Registres carregats de memòria. */
+  int      raddr;        /* Registres usats com a adreça. */
+  MDu32    changes;      /* Efectes laterals des de l'inici. */
+  MD_Bool  bank;         /* S'ha llegit la finestra del banc. */
+  MDu8     fm_status;    /* Estat del FM quan es va detectar. */
+  MDu32    cc;           /* Cicles executats. */
+  MDu32    cc_start;     /* Valor de 'cc' en l'última iteració. */
+  int      iter;         /* Cicles d'una iteració. */
+  
+} _idle;
+
 
 
 
@@ -122,6 +199,8 @@ mem_read (
     }
   
   /* 68K memory. */
+  else if ( _bank_mem != NULL )
+    return (Z80u8) _bank_mem[(addr&0x7FFF)^MD_BYTE_SWAP];
   else return (Z80u8) MD_mem_read8 ( _bank_select.addr | (addr&0x7FFF) );
   
 } /* end mem_read */
@@ -152,7 +231,11 @@ mem_write (
 {
   
   /* RAM */
-  if ( addr < 0x2000 ) _ram[addr]= data;
+  if ( addr < 0x2000 )
+    {
+      _ram[addr]= data;
+      MD_DIRTY_SET ( _dirty, addr>>DIRTY_PAGE_BITS );
+    }
   
   /* Registres */
   else if ( addr < 0x8000 )
@@ -170,6 +253,7 @@ mem_write (
             {
               _bank_select.bit= 0;
               _bank_select.addr= _bank_select.addr_tmp;
+              _bank_mem= MD_mem_get_bank_window ( _bank_select.addr );
             }
           break;
         case 0x7F11: MD_psg_control ( data ); break;
@@ -196,24 +280,303 @@ mem_write_trace (
 } /* end mem_write_trace */
 
 
+static Z80u8
+mem_read_watch (
+        	Z80u16 addr
+        	)
+{
+  
+  Z80u8 data;
+  
+  
+  data= mem_read ( addr );
+  if ( MD_WATCH_TEST ( _watch.rmap, addr ) )
+    MD_watch_check ( MD_WATCH_Z80, MD_READ, addr, 1, data );
+  
+  return data;
+  
+} /* end mem_read_watch */
+
+
 static void
-set_mode_mem_trace (
-        	    const MD_Bool val
-        	    )
+mem_write_watch (
+        	 Z80u16 addr,
+        	 Z80u8  data
+        	 )
+{
+  
+  mem_write ( addr, data );
+  if ( MD_WATCH_TEST ( _watch.wmap, addr ) )
+    MD_watch_check ( MD_WATCH_Z80, MD_WRITE, addr, 1, data );
+  
+} /* end mem_write_watch */
+
+
+/* Lectura en mode detecció de bucles. La primera lectura de cada
+ * instrucció és la de l'operació.
+ */
+static Z80u8
+mem_read_idle (
+               Z80u16 addr
+               )
 {
   
-  if ( _mem_access != NULL )
+  if ( _idle.first )
     {
-      if ( val )
+      _idle.pc= addr;
+      _idle.first= MD_FALSE;
+    }
+  if ( addr >= 0x8000 )
+    {
+      if ( _bank_mem != NULL ) _idle.bank= MD_TRUE;
+      else ++_idle.changes;
+    }
+  else if ( addr >= 0x2000 && (addr&0xE000) != 0x4000 ) ++_idle.changes;
+  
+  return mem_read ( addr );
+  
+} /* end mem_read_idle */
+
+
+static void
+mem_write_idle (
+        	Z80u16 addr,
+        	Z80u8  data
+        	)
+{
+  
+  ++_idle.changes;
+  mem_write ( addr, data );
+  
+} /* end mem_write_idle */
+
+
+/* Registres d'un operand registre. Torna 0 per a A i -1 si no és un
+ * registre que es puga seguir.
+ */
+static int
+idle_reg (
+          const int op
+          )
+{
+  
+  switch ( op )
+    {
+    case Z80_A: return 0;
+    case Z80_B: return IDLE_B;
+    case Z80_C: return IDLE_C;
+    case Z80_D: return IDLE_D;
+    case Z80_E: return IDLE_E;
+    case Z80_H: return IDLE_H;
+    case Z80_L: return IDLE_L;
+    case Z80_IXH: return IDLE_IXH;
+    case Z80_IXL: return IDLE_IXL;
+    case Z80_IYH: return IDLE_IYH;
+    case Z80_IYL: return IDLE_IYL;
+    case Z80_BC: return IDLE_B|IDLE_C;
+    case Z80_DE: return IDLE_D|IDLE_E;
+    case Z80_HL: return IDLE_H|IDLE_L;
+    case Z80_IX: return IDLE_IXH|IDLE_IXL;
+    case Z80_IY: return IDLE_IYH|IDLE_IYL;
+    default: return -1;
+    }
+  
+} /* end idle_reg */
+
+
+/* Registres que formen l'adreça d'un operand en memòria. Torna -1 si
+ * no és un operand en memòria.
+ */
+static int
+idle_addr (
+           const int op
+           )
+{
+  
+  switch ( op )
+    {
+    case Z80_ADDR: return 0;
+    case Z80_pBC: return IDLE_B|IDLE_C;
+    case Z80_pDE: return IDLE_D|IDLE_E;
+    case Z80_pHL: return IDLE_H|IDLE_L;
+    case Z80_pIX:
+    case Z80_pIXd: return IDLE_IXH|IDLE_IXL;
+    case Z80_pIY:
+    case Z80_pIYd: return IDLE_IYH|IDLE_IYL;
+    default: return -1;
+    }
+  
+} /* end idle_addr */
+
+
+/* Comprova un operand font d'AND, OR, CP o BIT. */
+static MD_Bool
+idle_src (
+          const int op
+          )
+{
+  
+  int addr;
+  
+  
+  if ( op == Z80_NONE || op == Z80_BYTE || idle_reg ( op ) >= 0 )
+    return MD_TRUE;
+  if ( (addr= idle_addr ( op )) < 0 ) return MD_FALSE;
+  _idle.raddr|= addr;
+  
+  return MD_TRUE;
+  
+} /* end idle_src */
+
+
+/* Descodifica la següent instrucció i deixa de comprovar el bucle si
+ * no és de les admeses.
+ */
+static void
+idle_check_next (void)
+{
+  
+  Z80_Step step;
+  int dst, addr;
+  MD_Bool ok;
+  
+  
+  Z80_decode_next_step ( &step );
+  if ( step.type != Z80_STEP_INST ) ok= MD_FALSE;
+  else switch ( step.val.inst.id.name )
+    {
+    case Z80_NOP: ok= MD_TRUE; break;
+    case Z80_LD:
+      dst= idle_reg ( step.val.inst.id.op1 );
+      if ( dst < 0 ) ok= MD_FALSE;
+      else if ( step.val.inst.id.op2 == Z80_BYTE ||
+        	step.val.inst.id.op2 == Z80_WORD )
+        ok= MD_TRUE;
+      else if ( (addr= idle_addr ( step.val.inst.id.op2 )) < 0 ) ok= MD_FALSE;
+      else
         {
-          _mem_read= mem_read_trace;
-          _mem_write= mem_write_trace;
+          _idle.wmem|= dst;
+          _idle.raddr|= addr;
+          ok= MD_TRUE;
         }
-      else
+      break;
+    case Z80_AND:
+    case Z80_OR:
+    case Z80_CP:
+      ok= idle_src ( step.val.inst.id.op1 ) &&
+        idle_src ( step.val.inst.id.op2 );
+      break;
+    case Z80_BIT: ok= idle_src ( step.val.inst.id.op2 ); break;
+    case Z80_JP:
+    case Z80_JR:
+      if ( (addr= idle_addr ( step.val.inst.id.op1 )) > 0 )
+        _idle.raddr|= addr;
+      ok= MD_TRUE;
+      break;
+    default: ok= MD_FALSE;
+    }
+  if ( !ok || (_idle.wmem&_idle.raddr) != 0 ) _idle.check= MD_FALSE;
+  
+} /* end idle_check_next */
+
+
+/* Torna a començar la comprovació del bucle candidat. */
+static void
+idle_restart (void)
+{
+  
+  _idle.mode= IDLE_CAND;
+  _idle.clean= 0;
+  _idle.check= MD_TRUE;
+  _idle.wmem= 0;
+  _idle.raddr= 0;
+  _idle.changes= 0;
+  
+} /* end idle_restart */
+
+
+/* Es crida després d'executar la primera instrucció d'un bucle (la
+ * instrucció anterior estava en una adreça igual o major). Quan el
+ * bucle està en espera torna els cicles de totes les iteracions que
+ * caben en els cicles pendents.
+ */
+static int
+idle_loop (
+           const int cc    /* Cicles de la instrucció. */
+           )
+{
+  
+  int n;
+  
+  
+  if ( _idle.mode == IDLE_NONE || _idle.head != _idle.pc )
+    {
+      _idle.head= _idle.pc;
+      _idle.fails= 0;
+      _idle.bank= MD_FALSE;
+      idle_restart ();
+      return 0;
+    }
+  switch ( _idle.mode )
+    {
+    case IDLE_CAND:
+    case IDLE_ANCHOR:
+      if ( _idle.fails >= IDLE_MAX_FAILS ) return 0;
+      if ( _idle.changes != 0 || !_idle.check )
+        {
+          if ( ++_idle.fails < IDLE_MAX_FAILS ) idle_restart ();
+          else _idle.check= MD_FALSE;
+          return 0;
+        }
+      if ( _idle.mode == IDLE_CAND )
         {
-          _mem_read= mem_read;
-          _mem_write= mem_write;
+          if ( ++_idle.clean == IDLE_CHECK_ITERS )
+            {
+              _idle.cc_start= _idle.cc;
+              _idle.mode= IDLE_ANCHOR;
+            }
+          return 0;
         }
+      _idle.iter= (int) (_idle.cc - _idle.cc_start);
+      if ( _idle.iter <= 0 ) return 0;
+      _idle.check= MD_FALSE;
+      _idle.fm_status= MD_fm_status ();
+      _idle.mode= IDLE_LOOP;
+      /* fall through */
+    case IDLE_LOOP:
+      n= (_cc/15 - cc)/_idle.iter;
+      return n > 0 ? n*_idle.iter : 0;
+    default: return 0;
+    }
+  
+} /* end idle_loop */
+
+
+static void
+set_mode_mem_trace (
+        	    const MD_Bool val
+        	    )
+{
+  
+  if ( val && _mem_access != NULL )
+    {
+      _mem_read= mem_read_trace;
+      _mem_write= mem_write_trace;
+    }
+  else if ( _watch.enabled )
+    {
+      _mem_read= mem_read_watch;
+      _mem_write= mem_write_watch;
+    }
+  else if ( _idle.enabled )
+    {
+      _mem_read= mem_read_idle;
+      _mem_write= mem_write_idle;
+    }
+  else
+    {
+      _mem_read= mem_read;
+      _mem_write= mem_write;
     }
   
 } /* end set_mode_mem_trace */
@@ -241,6 +604,13 @@ MD_z80_busreq_write (
 } /* end MD_z80_busreq_write */
 
 
+MD_Bool
+MD_z80_can_modify_68k (void)
+{
+  return !_control.busreq && _bank_select.addr >= 0x200000;
+} /* end MD_z80_can_modify_68k */
+
+
 void
 MD_z80_clock (
               const int cc
@@ -249,15 +619,62 @@ MD_z80_clock (
 
   // NOTA!! La fórmula per a obtindre els cicles del Z80 és: (cc*7)/15
   
+  int ret;
+  
+  
   if ( _control.busreq ) return;
   
   _cc+= 7*cc;
+  if ( _mem_read != mem_read_idle )
+    {
+      while ( _cc >= 15 )
+        _cc-= 15 * Z80_run ();
+      return;
+    }
+  
+  // Si el bucle en espera no ha vist cap canvi des de l'última
+  // porció es boten directament totes les iteracions que caben. Com
+  // el bucle és periòdic no cal estar a l'inici de la iteració.
+  if ( _idle.mode == IDLE_LOOP )
+    {
+      if ( _idle.changes != 0 || _idle.bank ||
+           MD_fm_status () != _idle.fm_status )
+        _idle.mode= IDLE_NONE;
+      else
+        {
+          ret= ((_cc/15)/_idle.iter)*_idle.iter;
+          _idle.cc+= ret;
+          _cc-= 15*ret;
+        }
+    }
   while ( _cc >= 15 )
-    _cc-= 15 * Z80_run ();
+    {
+      if ( _idle.check && _idle.mode != IDLE_NONE ) idle_check_next ();
+      _idle.first= MD_TRUE;
+      ret= Z80_run ();
+      if ( _idle.pc <= _idle.last_pc ) ret+= idle_loop ( ret );
+      _idle.last_pc= _idle.pc;
+      _idle.cc+= ret;
+      _cc-= 15*ret;
+    }
+  _idle.first= MD_FALSE;
   
 } // end MD_z80_clock
 
 
+void
+MD_z80_get_dirty (
+        	  MD_DirtyMap *ram
+        	  )
+{
+  
+  ram->bits= &(_dirty[0]);
+  ram->npages= 8192>>DIRTY_PAGE_BITS;
+  ram->page_bits= DIRTY_PAGE_BITS;
+  
+} /* end MD_z80_get_dirty */
+
+
 void
 MD_z80_init (
              MD_CPUStepZ80   *cpu_step,
@@ -276,6 +693,10 @@ MD_z80_init (
   _udata= udata;
   
   /* Funcions. */
+  _idle.enabled= MD_FALSE;
+  _watch.enabled= MD_FALSE;
+  _watch.rmap= MD_watch_get_map ( MD_WATCH_Z80, MD_READ );
+  _watch.wmap= MD_watch_get_map ( MD_WATCH_Z80, MD_WRITE );
   _mem_read= mem_read;
   _mem_write= mem_write;
 
@@ -290,15 +711,18 @@ MD_z80_init_state (void)
   
   /* Inicialitza memòria. */
   memset ( _ram, 0, 8192 );
+  memset ( _dirty, 0xFF, sizeof(_dirty) );
   _bank_select.addr= 0;
   _bank_select.addr_tmp= 0;
   _bank_select.bit= 0;
+  _bank_mem= MD_mem_get_bank_window ( _bank_select.addr );
   
   /* Inicialitza processador. */
   Z80_init_state ();
   
   /* Inicialitza timing. */
   _cc= 0;
+  _idle.mode= IDLE_NONE;
   
   /* control. */
   _control.busreq= MD_TRUE;
@@ -321,6 +745,7 @@ MD_z80_reset (
     {
       Z80_reset ();
       MD_fm_reset ();
+      ++_idle.changes;
     }
   _control.reset= reset;
   
@@ -339,6 +764,7 @@ MD_z80_trace (
 
   if ( _control.busreq ) return;
   
+  _idle.mode= IDLE_NONE;
   _cc+= 7*cc;
   while ( _cc >= 15 )
     {
@@ -395,6 +821,50 @@ void Z80_write (
 } /* end Z80_write */
 
 
+void
+MD_z80_set_idle_skip (
+        	      const MD_Bool enabled
+        	      )
+{
+  
+  _idle.enabled= enabled;
+  _idle.mode= IDLE_NONE;
+  set_mode_mem_trace ( MD_FALSE );
+  
+} /* end MD_z80_set_idle_skip */
+
+
+void
+MD_z80_set_int (
+        	const MD_Bool active
+        	)
+{
+  
+  ++_idle.changes;
+  Z80_IRQ ( active ? Z80_TRUE : Z80_FALSE, 0xFF );
+  
+} /* end MD_z80_set_int */
+
+
+void
+MD_z80_update_bank (void)
+{
+  _bank_mem= MD_mem_get_bank_window ( _bank_select.addr );
+} /* end MD_z80_update_bank */
+
+
+void
+MD_z80_set_watch (
+        	  const MD_Bool val
+        	  )
+{
+  
+  _watch.enabled= val;
+  set_mode_mem_trace ( MD_FALSE );
+  
+} /* end MD_z80_set_watch */
+
+
 int
 MD_z80_save_state (
         	   FILE *f
@@ -420,12 +890,15 @@ MD_z80_load_state (
   
   if ( Z80_load_state ( f ) != 0 ) return -1;
   LOAD ( _ram );
+  memset ( _dirty, 0xFF, sizeof(_dirty) );
   LOAD ( _bank_select );
   CHECK ( (_bank_select.addr&0xFF8000) == _bank_select.addr );
   CHECK ( (_bank_select.addr_tmp&0xFF8000) == _bank_select.addr_tmp );
   CHECK ( _bank_select.bit >= 0 && _bank_select.bit <= 8 );
+  _bank_mem= MD_mem_get_bank_window ( _bank_select.addr );
   LOAD ( _cc );
   LOAD ( _control );
+  _idle.mode= IDLE_NONE;
   
   return 0;
   